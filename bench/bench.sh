@@ -0,0 +1,85 @@
+#!/bin/sh
+# SPDX-License-Identifier: GPL-2.0
+#
+# Guest side of the QEMU benchmark, see Benchmark.md
+#
+# bench.sh <mmc host> <output dir> [fio|poll]
+#   fio  (default): fio read/write/randread/randwrite at queue depth 1..32,
+#                   then mmc_test
+#   poll:           sync random reads at queue depth 1, irq vs. polled
+#                   completion (i.MX6Q)
+#
+# fio writes one JSON file per job, mmc_test results and the driver
+# debugfs counters go next to them.
+
+HOST=$1
+OUT=$2
+SUITE=${3:-fio}
+
+if [ -z "$HOST" ] || [ -z "$OUT" ]; then
+	echo "usage: $0 <mmc host> <output dir> [fio|poll]" >&2
+	exit 1
+fi
+
+DEV=/dev/mmcblk${HOST#mmc}
+DBG=/sys/kernel/debug/$HOST
+mkdir -p $OUT
+
+snap() {
+	for f in $DBG/basicdrv_*; do
+		[ -r $f ] && { echo "== $f"; cat $f; }
+	done > $OUT/$1.debugfs 2>/dev/null
+}
+
+run_fio() {
+	snap before
+	for rw in read write randread randwrite; do
+		case $rw in
+		rand*)	bs=4k ;;
+		*)	bs=512k ;;
+		esac
+		for qd in 1 2 4 8 16 32; do
+			fio --name=$rw-qd$qd --filename=$DEV --direct=1 \
+			    --ioengine=libaio --rw=$rw --bs=$bs --iodepth=$qd \
+			    --size=256M --runtime=30 --time_based --randseed=1 \
+			    --output-format=json --output=$OUT/$rw-qd$qd.json
+		done
+	done
+	snap fio
+
+	# mmc_test takes the card away from the block driver
+	CARD=$(basename $(ls -d /sys/bus/mmc/devices/$HOST:*))
+	echo $CARD > /sys/bus/mmc/drivers/mmcblk/unbind
+	echo $CARD > /sys/bus/mmc/drivers/mmc_test/bind
+	echo 0 > $DBG/$CARD/test		# 0: all tests
+	cat $DBG/$CARD/test > $OUT/mmc_test.txt
+	echo $CARD > /sys/bus/mmc/drivers/mmc_test/unbind
+	echo $CARD > /sys/bus/mmc/drivers/mmcblk/bind
+	snap after
+}
+
+run_poll() {
+	if [ ! -w $DBG/basicdrv_poll_max_bytes ]; then
+		echo "$HOST: no basicdrv_poll_max_bytes (uSDHC only)" >&2
+		exit 1
+	fi
+
+	for mode in irq poll; do
+		[ $mode = poll ] && v=4096 || v=0
+		echo $v > $DBG/basicdrv_poll_max_bytes
+		for bs in 512 4k; do
+			fio --name=$mode-$bs --filename=$DEV --direct=1 \
+			    --ioengine=psync --rw=randread --bs=$bs --size=256M \
+			    --runtime=30 --time_based --randseed=1 \
+			    --output-format=json --output=$OUT/$mode-$bs.json
+		done
+		cat $DBG/basicdrv_stats > $OUT/$mode.stats
+	done
+	echo 0 > $DBG/basicdrv_poll_max_bytes
+}
+
+case $SUITE in
+fio)	run_fio ;;
+poll)	run_poll ;;
+*)	echo "unknown suite \"$SUITE\"" >&2; exit 1 ;;
+esac
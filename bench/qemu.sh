@@ -0,0 +1,64 @@
+#!/bin/sh
+# SPDX-License-Identifier: GPL-2.0
+#
+# Host side of the QEMU benchmark, see Benchmark.md
+#
+# qemu.sh <sabrelite|microzed> <kernel build dir> <rootfs.cpio.gz> <sd.img> [kernel args...]
+#   sabrelite: i.MX6Q, uSDHC model, imx6q-sabrelite.dtb + imx6q-sabrelite-basicdrv.dtso
+#   microzed:  xilinx-zynq-a9, Arasan SDHCI model, microzed/zynq-microzed.bootup.dts
+#
+# The SD image is a scratch device, bench.sh overwrites it.
+# -icount makes guest time follow executed instructions instead of host
+# load, so two builds can be compared run-to-run. Set QEMU_ICOUNT to
+# change it, QEMU to use another binary.
+
+set -e
+
+BENCH=$(cd $(dirname $0) && pwd)
+REPO=$(dirname $BENCH)
+
+if [ $# -lt 4 ]; then
+	echo "usage: $0 <sabrelite|microzed> <kernel build dir> <rootfs.cpio.gz> <sd.img> [kernel args...]" >&2
+	exit 1
+fi
+
+BOARD=$1
+KDIR=$2
+INITRD=$3
+SDIMG=$4
+shift 4
+
+QEMU=${QEMU:-qemu-system-arm}
+QEMU_ICOUNT=${QEMU_ICOUNT:-shift=1,sleep=off}
+DTS=$KDIR/arch/arm/boot/dts
+DTB=$(mktemp -d)/$BOARD.dtb
+
+case $BOARD in
+sabrelite)
+	# bench.sh's card is on usdhc4 (-drive index=3)
+	dtc -q -I dts -O dtb -o ${DTB%.dtb}.dtbo \
+		$BENCH/imx6q-sabrelite-basicdrv.dtso
+	fdtoverlay -i $DTS/imx6q-sabrelite.dtb -o $DTB ${DTB%.dtb}.dtbo
+	MACHINE="-M sabrelite -smp 4"
+	SD="index=3"
+	CONSOLE=ttymxc1
+	;;
+microzed)
+	dtc -q -I dts -O dtb -i $DTS -o $DTB \
+		$REPO/microzed/zynq-microzed.bootup.dts
+	MACHINE="-M xilinx-zynq-a9"
+	SD="index=0"
+	CONSOLE=ttyPS0,115200
+	;;
+*)
+	echo "unknown board \"$BOARD\"" >&2
+	exit 1
+	;;
+esac
+
+exec $QEMU $MACHINE -m 1G \
+	-icount $QEMU_ICOUNT \
+	-display none -serial null -serial stdio \
+	-kernel $KDIR/arch/arm/boot/zImage -dtb $DTB -initrd $INITRD \
+	-drive file=$SDIMG,if=sd,format=raw,$SD \
+	-append "console=$CONSOLE rdinit=/sbin/init $*"
@@ -0,0 +1,666 @@
+// SPDX-License-Identifier: GPL-2.0
+/*
+ * KUnit tests of the i.MX6QP Basic Driver register accessors
+ *
+ * Included at the end of sdhci-of-basicdrv.imx6qp.c, so the static
+ * accessors can be called directly. host->ioaddr points to an in-memory
+ * register file: no hardware, no interrupts, the tests only check the
+ * SDHCI <-> uSDHC bit layouts and the number of MMIO accesses each
+ * sdhci_ops call costs. esdhc_test_bench only reports the CPU cost of
+ * the accessors.
+ *
+ * Copyright (c) 2018  alamy.liu@gmail.com
+ */
+
+#include <kunit/test.h>
+#include <linux/timex.h>
+
+#define ESDHC_TEST_REGS_SIZE	SZ_4K
+#define ESDHC_TEST_HOST_CLOCK	198000000U	/* PER clock, PLL2 PFD2 */
+#define ESDHC_TEST_BENCH_LOOPS	10000
+
+struct esdhc_test {
+	struct sdhci_host *host;
+	struct sdhci_ops ops;	/* sdhci_basicdrv_ops, self-clearing resets */
+	u32 *regs;		/* mock uSDHC register file */
+	u64 reads;		/* MMIO counters at the last esdhc_test_cost() */
+	u64 writes;
+};
+
+static u32 esdhc_test_reg(struct esdhc_test *t, int reg)
+{
+	return t->regs[reg / 4];
+}
+
+static void esdhc_test_set_reg(struct esdhc_test *t, int reg, u32 val)
+{
+	t->regs[reg / 4] = val;
+}
+
+/* The reset bits self-clear as soon as sdhci_reset() polls them */
+static u8 esdhc_test_readb(struct sdhci_host *host, int reg)
+{
+	u32 *regs = (u32 __force *)host->ioaddr;
+
+	if (reg == SDHCI_SOFTWARE_RESET)
+		regs[ESDHC_SYSTEM_CONTROL / 4] &= ~ESDHC_SYS_CTRL_RST_MASK;
+
+	return esdhc_readb(host, reg);
+}
+
+/* The accesses since the last call must be exactly reads + writes */
+static void esdhc_test_cost(struct kunit *test, u64 reads, u64 writes)
+{
+	struct esdhc_test *t = test->priv;
+	struct pltfm_imx_data *imx_data = esdhc_priv(t->host);
+
+	KUNIT_EXPECT_EQ(test, imx_data->mmio_reads - t->reads, reads);
+	KUNIT_EXPECT_EQ(test, imx_data->mmio_writes - t->writes, writes);
+	t->reads = imx_data->mmio_reads;
+	t->writes = imx_data->mmio_writes;
+}
+
+static int esdhc_test_init(struct kunit *test)
+{
+	struct esdhc_test *t;
+	struct sdhci_host *host;
+
+	t = kunit_kzalloc(test, sizeof(*t), GFP_KERNEL);
+	if (!t)
+		return -ENOMEM;
+
+	/* same layout as sdhci_pltfm_init(): host, pltfm host, imx_data */
+	host = kunit_kzalloc(test, sizeof(*host) +
+			sizeof(struct sdhci_pltfm_host) +
+			sizeof(struct pltfm_imx_data), GFP_KERNEL);
+	t->regs = kunit_kzalloc(test, ESDHC_TEST_REGS_SIZE, GFP_KERNEL);
+	if (!host || !t->regs)
+		return -ENOMEM;
+	host->mmc = kunit_kzalloc(test, sizeof(*host->mmc), GFP_KERNEL);
+	if (!host->mmc)
+		return -ENOMEM;
+
+	/* sdhci_readl() & co. dispatch through host->ops */
+	t->ops = sdhci_basicdrv_ops;
+	t->ops.read_b = esdhc_test_readb;
+	host->ops = &t->ops;
+	host->ioaddr = (void __iomem *)t->regs;
+	spin_lock_init(&host->lock);
+	((struct sdhci_pltfm_host *)sdhci_priv(host))->clock =
+		ESDHC_TEST_HOST_CLOCK;
+
+	esdhc_priv(host)->host = host;
+	esdhc_priv(host)->pinctrl = ERR_PTR(-ENODEV);	/* no pin states */
+	esdhc_priv(host)->data_timeout_margin = ESDHC_DATA_TIMEOUT_MARGIN;
+	t->host = host;
+	test->priv = t;
+
+	/* the SD clock is stable right away */
+	esdhc_test_set_reg(t, ESDHC_PRSSTAT, ESDHC_CLOCK_STABLE);
+
+	return 0;
+}
+
+/* ADMA error: bit 25 in SDHCI, bit 28 on uSDHC */
+static void esdhc_test_int_adma_error(struct kunit *test)
+{
+	struct esdhc_test *t = test->priv;
+
+	esdhc_test_set_reg(t, SDHCI_INT_STATUS,
+		ESDHC_INT_VENDOR_SPEC_DMA_ERR | SDHCI_INT_DATA_END);
+	KUNIT_EXPECT_EQ(test, esdhc_readl(t->host, SDHCI_INT_STATUS),
+		(u32)(SDHCI_INT_ADMA_ERROR | SDHCI_INT_DATA_END));
+	esdhc_test_cost(test, 1, 0);
+
+	esdhc_writel(t->host, SDHCI_INT_ADMA_ERROR | SDHCI_INT_RESPONSE,
+		SDHCI_INT_ENABLE);
+	KUNIT_EXPECT_EQ(test, esdhc_test_reg(t, SDHCI_INT_ENABLE),
+		(u32)(ESDHC_INT_VENDOR_SPEC_DMA_ERR | SDHCI_INT_RESPONSE));
+	esdhc_test_cost(test, 0, 1);
+}
+
+/* Completions held by the coalescing window are masked and hidden */
+static void esdhc_test_int_held(struct kunit *test)
+{
+	struct esdhc_test *t = test->priv;
+	u32 mask = SDHCI_INT_CQE | SDHCI_INT_CARD_INSERT;
+
+	esdhc_priv(t->host)->irq_held = SDHCI_INT_CQE;
+
+	esdhc_test_set_reg(t, SDHCI_INT_STATUS, mask);
+	KUNIT_EXPECT_EQ(test, esdhc_readl(t->host, SDHCI_INT_STATUS),
+		(u32)SDHCI_INT_CARD_INSERT);
+
+	esdhc_writel(t->host, mask, SDHCI_SIGNAL_ENABLE);
+	KUNIT_EXPECT_EQ(test, esdhc_test_reg(t, SDHCI_SIGNAL_ENABLE),
+		(u32)SDHCI_INT_CARD_INSERT);
+	esdhc_test_cost(test, 1, 1);
+}
+
+/* sdhci_ops.irq runs under host->lock, from sdhci_irq() */
+static u32 esdhc_test_coalesce(struct sdhci_host *host, u32 intmask)
+{
+	unsigned long flags;
+
+	spin_lock_irqsave(&host->lock, flags);
+	intmask = imx6q_basicdrv_irq_coalesce(host, intmask);
+	spin_unlock_irqrestore(&host->lock, flags);
+
+	return intmask;
+}
+
+/*
+ * Without CQE the response of a data command waits for its transfer
+ * complete, both go to sdhci_irq() as one interrupt.
+ */
+static void esdhc_test_int_coalesce(struct kunit *test)
+{
+	struct esdhc_test *t = test->priv;
+	struct pltfm_imx_data *imx_data = esdhc_priv(t->host);
+	struct mmc_data data = {};
+	struct mmc_command cmd = { .data = &data };
+
+	hrtimer_init(&imx_data->irq_timer, CLOCK_MONOTONIC, HRTIMER_MODE_REL);
+	imx_data->irq_timer.function = imx6q_basicdrv_irq_timer;
+	/* long enough for the timer not to fire during the test */
+	imx_data->irq_coalesce_us = ESDHC_IRQ_COALESCE_MAX_US;
+	t->host->ier = SDHCI_INT_RESPONSE | SDHCI_INT_DATA_END;
+
+	/* no data: nothing to wait for */
+	t->host->cmd = &cmd;
+	KUNIT_EXPECT_EQ(test, esdhc_test_coalesce(t->host, SDHCI_INT_RESPONSE),
+		(u32)SDHCI_INT_RESPONSE);
+
+	t->host->data = &data;
+	t->host->data_cmd = &cmd;
+	KUNIT_EXPECT_EQ(test, esdhc_test_coalesce(t->host, SDHCI_INT_RESPONSE),
+		(u32)0);
+	KUNIT_EXPECT_EQ(test, esdhc_test_reg(t, SDHCI_SIGNAL_ENABLE),
+		(u32)SDHCI_INT_DATA_END);
+	KUNIT_EXPECT_EQ(test, imx_data->irq_windows, (u64)1);
+
+	KUNIT_EXPECT_EQ(test, esdhc_test_coalesce(t->host, SDHCI_INT_DATA_END),
+		(u32)(SDHCI_INT_RESPONSE | SDHCI_INT_DATA_END));
+	KUNIT_EXPECT_EQ(test, imx_data->irq_held, (u32)0);
+	KUNIT_EXPECT_EQ(test, esdhc_test_reg(t, SDHCI_SIGNAL_ENABLE),
+		t->host->ier);
+
+	/* budget over: the interrupt the timer lets through is handled */
+	esdhc_test_coalesce(t->host, SDHCI_INT_RESPONSE);
+	hrtimer_cancel(&imx_data->irq_timer);
+	imx6q_basicdrv_irq_timer(&imx_data->irq_timer);
+	KUNIT_EXPECT_EQ(test, esdhc_test_coalesce(t->host, SDHCI_INT_RESPONSE),
+		(u32)SDHCI_INT_RESPONSE);
+	KUNIT_EXPECT_EQ(test, imx_data->irq_windows, (u64)2);
+}
+
+/* DAT[3:0] level: bits 27:24 -> 23:20, CMD level: bit 23 -> 24 */
+static void esdhc_test_present_state(struct kunit *test)
+{
+	struct esdhc_test *t = test->priv;
+
+	esdhc_test_set_reg(t, SDHCI_PRESENT_STATE,
+		0x0F800000 | SDHCI_CMD_INHIBIT);
+	KUNIT_EXPECT_EQ(test, esdhc_readl(t->host, SDHCI_PRESENT_STATE),
+		(u32)(SDHCI_DATA_LVL_MASK | SDHCI_CMD_LVL | SDHCI_CMD_INHIBIT));
+	esdhc_test_cost(test, 1, 0);
+}
+
+/* Capabilities: ADMA2 is reported in the ADMA1 bit */
+static void esdhc_test_caps(struct kunit *test)
+{
+	struct esdhc_test *t = test->priv;
+	u32 caps;
+
+	esdhc_test_set_reg(t, SDHCI_CAPABILITIES, SDHCI_CAN_DO_ADMA1);
+	caps = esdhc_readl(t->host, SDHCI_CAPABILITIES);
+	KUNIT_EXPECT_EQ(test, caps & (SDHCI_CAN_DO_ADMA1 | SDHCI_CAN_DO_ADMA2),
+		(u32)SDHCI_CAN_DO_ADMA2);
+	esdhc_test_cost(test, 1, 0);
+
+	/* faked registers do not touch the hardware */
+	KUNIT_EXPECT_EQ(test, esdhc_readw(t->host, SDHCI_HOST_VERSION),
+		(u16)SDHCI_SPEC_300);
+	caps = esdhc_readl(t->host, SDHCI_CAPABILITIES_1);
+	KUNIT_EXPECT_EQ(test, caps & SDHCI_SUPPORT_SDR104,
+		(u32)SDHCI_SUPPORT_SDR104);
+	esdhc_readl(t->host, SDHCI_MAX_CURRENT);
+	esdhc_test_cost(test, 0, 0);
+}
+
+/*
+ * Command issue (SDHCI_TRANSFER_MODE + SDHCI_COMMAND): AC23 moves to
+ * MIX_CTRL bit 7, the command goes to the upper half of XFERTYP.
+ * The hot path: two posted writes, no read-back.
+ */
+static void esdhc_test_cmd_issue(struct kunit *test)
+{
+	struct esdhc_test *t = test->priv;
+	struct mmc_command cmd = { .opcode = MMC_READ_SINGLE_BLOCK };
+	u16 mode = SDHCI_TRNS_READ | SDHCI_TRNS_DMA | SDHCI_TRNS_AUTO_CMD23;
+	u16 command = SDHCI_MAKE_CMD(cmd.opcode,
+		(SDHCI_CMD_RESP_SHORT | SDHCI_CMD_DATA));
+
+	t->host->cmd = &cmd;
+	esdhc_writew(t->host, mode, SDHCI_TRANSFER_MODE);
+	esdhc_writew(t->host, command, SDHCI_COMMAND);
+	esdhc_test_cost(test, 0, 2);
+
+	KUNIT_EXPECT_EQ(test, esdhc_test_reg(t, ESDHC_MIX_CTRL),
+		(u32)(SDHCI_TRNS_READ | SDHCI_TRNS_DMA | ESDHC_MIX_CTRL_AC23EN));
+	KUNIT_EXPECT_EQ(test, esdhc_test_reg(t, SDHCI_TRANSFER_MODE),
+		(u32)command << 16);
+
+	/* MIX_CTRL is shadowed */
+	KUNIT_EXPECT_EQ(test, esdhc_readw(t->host, SDHCI_TRANSFER_MODE), mode);
+	esdhc_test_cost(test, 0, 0);
+
+	/* CMD12 is an abort command on uSDHC */
+	cmd.opcode = MMC_STOP_TRANSMISSION;
+	esdhc_writew(t->host, SDHCI_MAKE_CMD(cmd.opcode, 0), SDHCI_COMMAND);
+	KUNIT_EXPECT_EQ(test, esdhc_test_reg(t, SDHCI_TRANSFER_MODE) >> 16,
+		(u32)SDHCI_MAKE_CMD(cmd.opcode, SDHCI_CMD_ABORTCMD));
+	esdhc_test_cost(test, 0, 1);
+}
+
+/* DMA select: bits 4:3 -> 9:8, bus width and D3CD are left alone */
+static void esdhc_test_host_control(struct kunit *test)
+{
+	struct esdhc_test *t = test->priv;
+
+	esdhc_test_set_reg(t, SDHCI_HOST_CONTROL,
+		ESDHC_CTRL_4BITBUS | ESDHC_CTRL_D3CD);
+	esdhc_writeb(t->host, SDHCI_CTRL_LED | SDHCI_CTRL_ADMA32,
+		SDHCI_HOST_CONTROL);
+	KUNIT_EXPECT_EQ(test, esdhc_test_reg(t, SDHCI_HOST_CONTROL),
+		(u32)(SDHCI_CTRL_LED | ESDHC_HOST_CONTROL_LE |
+		      (SDHCI_CTRL_ADMA32 << 5) |
+		      ESDHC_CTRL_4BITBUS | ESDHC_CTRL_D3CD));
+	esdhc_test_cost(test, 1, 1);
+
+	KUNIT_EXPECT_EQ(test, esdhc_readb(t->host, SDHCI_HOST_CONTROL),
+		(u8)(SDHCI_CTRL_LED | SDHCI_CTRL_ADMA32 | SDHCI_CTRL_4BITBUS));
+	esdhc_test_cost(test, 1, 0);
+
+	imx6q_basicdrv_set_bus_width(t->host, MMC_BUS_WIDTH_8);
+	KUNIT_EXPECT_EQ(test, (u8)(esdhc_readb(t->host, SDHCI_HOST_CONTROL) &
+		(SDHCI_CTRL_4BITBUS | SDHCI_CTRL_8BITBUS)),
+		(u8)SDHCI_CTRL_8BITBUS);
+	esdhc_test_cost(test, 2, 1);
+
+	/* no power control on uSDHC */
+	esdhc_writeb(t->host, SDHCI_POWER_ON | SDHCI_POWER_330,
+		SDHCI_POWER_CONTROL);
+	esdhc_test_cost(test, 0, 0);
+}
+
+/* HOST_CONTROL2 and CLOCK_CONTROL live in VENDOR_SPEC and MIX_CTRL */
+static void esdhc_test_host_control2(struct kunit *test)
+{
+	struct esdhc_test *t = test->priv;
+
+	esdhc_writew(t->host, SDHCI_CTRL_VDD_180 | SDHCI_CTRL_TUNED_CLK,
+		SDHCI_HOST_CONTROL2);
+	KUNIT_EXPECT_EQ(test, esdhc_test_reg(t, ESDHC_VENDOR_SPEC),
+		(u32)ESDHC_VENDOR_SPEC_VSELECT);
+	KUNIT_EXPECT_EQ(test, esdhc_test_reg(t, ESDHC_MIX_CTRL),
+		(u32)(ESDHC_MIX_CTRL_SMPCLK_SEL | ESDHC_MIX_CTRL_AUTO_TUNE_EN));
+	esdhc_test_cost(test, 0, 2);
+
+	KUNIT_EXPECT_EQ(test, esdhc_readw(t->host, SDHCI_HOST_CONTROL2),
+		(u16)(SDHCI_CTRL_VDD_180 | SDHCI_CTRL_TUNED_CLK));
+	esdhc_test_cost(test, 0, 0);
+
+	esdhc_writew(t->host, SDHCI_CLOCK_CARD_EN, SDHCI_CLOCK_CONTROL);
+	KUNIT_EXPECT_EQ(test, esdhc_test_reg(t, ESDHC_VENDOR_SPEC),
+		(u32)(ESDHC_VENDOR_SPEC_VSELECT |
+		      ESDHC_VENDOR_SPEC_FRC_SDCLK_ON));
+	esdhc_test_cost(test, 0, 1);
+}
+
+/* esdhc_clrset(): SYSCTL from the shadow, others read-modify-write */
+static void esdhc_test_clrset(struct kunit *test)
+{
+	struct esdhc_test *t = test->priv;
+
+	esdhc_writeb(t->host, 0xe, SDHCI_TIMEOUT_CONTROL);
+	KUNIT_EXPECT_EQ(test, esdhc_test_reg(t, ESDHC_SYSTEM_CONTROL),
+		(u32)0xe << 16);
+	esdhc_test_cost(test, 0, 1);
+
+	/* SDMA buffer boundary is not used */
+	esdhc_writew(t->host, SDHCI_MAKE_BLKSZ(7, 512), SDHCI_BLOCK_SIZE);
+	KUNIT_EXPECT_EQ(test, esdhc_test_reg(t, SDHCI_BLOCK_SIZE) & 0xffff,
+		(u32)512);
+	esdhc_test_cost(test, 1, 1);
+}
+
+/* RESET_ALL: reload the shadows, keep only the tuning bits of MIX_CTRL */
+static void esdhc_test_reset_all(struct kunit *test)
+{
+	struct esdhc_test *t = test->priv;
+	u32 mix = ESDHC_MIX_CTRL_AC23EN | ESDHC_MIX_CTRL_SMPCLK_SEL |
+		ESDHC_MIX_CTRL_AUTO_TUNE_EN;
+
+	esdhc_write_mix_ctrl(t->host, mix);
+	esdhc_priv(t->host)->wtmk_lvl = 0x08200820;
+	esdhc_test_cost(test, 0, 1);
+
+	esdhc_writeb(t->host, SDHCI_RESET_ALL, SDHCI_SOFTWARE_RESET);
+	/* the shadows are left alone until RSTA self-clears */
+	KUNIT_EXPECT_EQ(test, esdhc_priv(t->host)->mix_ctrl, mix);
+	esdhc_test_cost(test, 0, 1);
+
+	esdhc_test_set_reg(t, ESDHC_SYSTEM_CONTROL,
+		esdhc_test_reg(t, ESDHC_SYSTEM_CONTROL) &
+		~ESDHC_SYS_CTRL_RST_MASK);
+	esdhc_reset_all_done(t->host);
+	KUNIT_EXPECT_EQ(test, esdhc_test_reg(t, ESDHC_MIX_CTRL),
+		mix & ESDHC_MIX_CTRL_TUNING_MASK);
+	KUNIT_EXPECT_EQ(test, esdhc_priv(t->host)->mix_ctrl,
+		mix & ESDHC_MIX_CTRL_TUNING_MASK);
+	KUNIT_EXPECT_EQ(test, esdhc_test_reg(t, ESDHC_SYSTEM_CONTROL) & 0x7,
+		(u32)0x7);
+	KUNIT_EXPECT_EQ(test, esdhc_test_reg(t, ESDHC_WTMK_LVL),
+		esdhc_priv(t->host)->wtmk_lvl);
+	/* shadow reload (4), clocks back on, MIX_CTRL, WTMK_LVL */
+	esdhc_test_cost(test, 4, 3);
+}
+
+/* DAT line reset keeps the bus width, RESET_ALL restores the IRQ enables */
+static void esdhc_test_reset(struct kunit *test)
+{
+	struct esdhc_test *t = test->priv;
+	struct pltfm_imx_data *imx_data = esdhc_priv(t->host);
+
+	esdhc_test_set_reg(t, SDHCI_HOST_CONTROL, ESDHC_CTRL_4BITBUS);
+	imx6q_basicdrv_reset(t->host, SDHCI_RESET_CMD | SDHCI_RESET_DATA);
+	KUNIT_EXPECT_EQ(test, esdhc_test_reg(t, SDHCI_HOST_CONTROL),
+		(u32)ESDHC_CTRL_4BITBUS);
+	KUNIT_EXPECT_EQ(test, imx_data->line_resets, (u64)1);
+	KUNIT_EXPECT_EQ(test, imx_data->full_resets, (u64)0);
+
+	t->host->ier = SDHCI_INT_RESPONSE | SDHCI_INT_DATA_END;
+	t->host->clock = 50000000;
+	imx6q_basicdrv_reset(t->host, SDHCI_RESET_ALL);
+	KUNIT_EXPECT_EQ(test, t->host->clock, 0U);
+	KUNIT_EXPECT_EQ(test, imx_data->full_resets, (u64)1);
+	KUNIT_EXPECT_EQ(test, esdhc_test_reg(t, SDHCI_INT_ENABLE),
+		t->host->ier);
+	KUNIT_EXPECT_EQ(test, esdhc_test_reg(t, SDHCI_SIGNAL_ENABLE),
+		t->host->ier);
+	KUNIT_EXPECT_EQ(test, esdhc_test_reg(t, ESDHC_SYSTEM_CONTROL),
+		(u32)0x7);
+}
+
+/* PER clock / (16 x 256) .. PER clock */
+static void esdhc_test_max_min_clock(struct kunit *test)
+{
+	struct esdhc_test *t = test->priv;
+
+	KUNIT_EXPECT_EQ(test, imx6q_basicdrv_get_max_clock(t->host),
+		ESDHC_TEST_HOST_CLOCK);
+	KUNIT_EXPECT_EQ(test, imx6q_basicdrv_get_min_clock(t->host),
+		ESDHC_TEST_HOST_CLOCK / 256 / 16);
+	esdhc_test_cost(test, 0, 0);
+}
+
+/*
+ * set_clock: program the dividers and wait for SDSTB. The same rate
+ * again after CARD_EN was dropped only forces the clock back on.
+ */
+static void esdhc_test_set_clock(struct kunit *test)
+{
+	struct esdhc_test *t = test->priv;
+	u32 mask = ESDHC_CLOCK_EN_MASK | ESDHC_CLOCK_MASK;
+
+	/* 198 MHz / 4 */
+	imx6q_basicdrv_set_clock(t->host, 50000000);
+	KUNIT_EXPECT_EQ(test, t->host->mmc->actual_clock, 49500000U);
+	KUNIT_EXPECT_EQ(test, esdhc_test_reg(t, ESDHC_SYSTEM_CONTROL) & mask,
+		(u32)(ESDHC_CLOCK_EN_MASK | (3 << ESDHC_DIVIDER_SHIFT)));
+	KUNIT_EXPECT_EQ(test, esdhc_test_reg(t, ESDHC_VENDOR_SPEC),
+		(u32)ESDHC_VENDOR_SPEC_FRC_SDCLK_ON);
+	/* clock off, dividers, FRC_SDCLK_ON, SDSTB */
+	esdhc_test_cost(test, 1, 3);
+
+	esdhc_writew(t->host, 0, SDHCI_CLOCK_CONTROL);
+	KUNIT_EXPECT_EQ(test, esdhc_test_reg(t, ESDHC_VENDOR_SPEC), (u32)0);
+	esdhc_test_cost(test, 0, 1);
+
+	imx6q_basicdrv_set_clock(t->host, 50000000);
+	KUNIT_EXPECT_EQ(test, esdhc_test_reg(t, ESDHC_VENDOR_SPEC),
+		(u32)ESDHC_VENDOR_SPEC_FRC_SDCLK_ON);
+	esdhc_test_cost(test, 0, 1);
+
+	imx6q_basicdrv_set_clock(t->host, 0);
+	KUNIT_EXPECT_EQ(test, t->host->mmc->actual_clock, 0U);
+	KUNIT_EXPECT_EQ(test, esdhc_test_reg(t, ESDHC_VENDOR_SPEC), (u32)0);
+	esdhc_test_cost(test, 0, 1);
+}
+
+/* DTOCV from the card's timeout + margin, in SYSCTL[19:16] */
+static void esdhc_test_set_timeout(struct kunit *test)
+{
+	struct esdhc_test *t = test->priv;
+	struct mmc_data data = { .timeout_ns = 100000000 };
+	struct mmc_command cmd = { .data = &data };
+
+	/* 100 ms + 100 % at 50 MHz: 10^7 SDCLK <= 2^(10 + 14) */
+	t->host->mmc->actual_clock = 50000000;
+	imx6q_basicdrv_set_timeout(t->host, &cmd);
+	KUNIT_EXPECT_EQ(test, esdhc_test_reg(t, ESDHC_SYSTEM_CONTROL),
+		(u32)10 << 16);
+	esdhc_test_cost(test, 0, 1);
+
+	/* far beyond SDCLK x 2^29 */
+	cmd.data = NULL;
+	cmd.busy_timeout = UINT_MAX;
+	imx6q_basicdrv_set_timeout(t->host, &cmd);
+	KUNIT_EXPECT_EQ(test, esdhc_test_reg(t, ESDHC_SYSTEM_CONTROL),
+		(u32)ESDHC_SYS_CTRL_DTOCV_MAX << 16);
+
+	/* no SD clock yet */
+	t->host->mmc->actual_clock = 0;
+	cmd.busy_timeout = 1;
+	imx6q_basicdrv_set_timeout(t->host, &cmd);
+	KUNIT_EXPECT_EQ(test, esdhc_test_reg(t, ESDHC_SYSTEM_CONTROL),
+		(u32)ESDHC_SYS_CTRL_DTOCV_MAX << 16);
+}
+
+/* UHS timing: reset the tuning circuit, DDREN only for DDR modes */
+static void esdhc_test_set_uhs_signaling(struct kunit *test)
+{
+	struct esdhc_test *t = test->priv;
+	struct pltfm_imx_data *imx_data = esdhc_priv(t->host);
+
+	esdhc_write_mix_ctrl(t->host, ESDHC_MIX_CTRL_SMPCLK_SEL |
+		ESDHC_MIX_CTRL_FBCLK_SEL | ESDHC_MIX_CTRL_AUTO_TUNE_EN);
+	esdhc_write_tune_ctrl(t->host, 0x1234);
+	esdhc_test_cost(test, 0, 2);
+
+	imx6q_basicdrv_set_uhs_signaling(t->host, MMC_TIMING_UHS_DDR50);
+	KUNIT_EXPECT_EQ(test, esdhc_test_reg(t, ESDHC_MIX_CTRL),
+		(u32)(ESDHC_MIX_CTRL_AUTO_TUNE_EN | ESDHC_MIX_CTRL_DDREN));
+	KUNIT_EXPECT_EQ(test, esdhc_test_reg(t, ESDHC_TUNE_CTRL_STATUS), (u32)0);
+	KUNIT_EXPECT_TRUE(test, imx_data->is_ddr);
+	esdhc_test_cost(test, 0, 3);
+
+	imx6q_basicdrv_set_uhs_signaling(t->host, MMC_TIMING_UHS_SDR104);
+	KUNIT_EXPECT_EQ(test, esdhc_test_reg(t, ESDHC_MIX_CTRL),
+		(u32)ESDHC_MIX_CTRL_AUTO_TUNE_EN);
+	KUNIT_EXPECT_FALSE(test, imx_data->is_ddr);
+	esdhc_test_cost(test, 0, 3);
+}
+
+/* Divider table: PER clocks seen on i.MX6, SD clocks the core asks for */
+static const unsigned int esdhc_test_host_clocks[] = {
+	24000000, 132000000, 198000000, 200000000, 396000000,
+};
+
+static const unsigned int esdhc_test_sd_clocks[] = {
+	400000, 20000000, 25000000, 26000000, 50000000, 52000000,
+	100000000, 200000000,
+};
+
+/* actual <= requested, and it is what the programmed dividers give */
+static void esdhc_test_calc_clock(struct kunit *test)
+{
+	struct esdhc_test *t = test->priv;
+	struct pltfm_imx_data *imx_data = esdhc_priv(t->host);
+	struct esdhc_clk_div *d;
+	unsigned int host_clock, clock, pre_div, div;
+	int i, j, ddr;
+
+	for (ddr = 0; ddr < 2; ddr++) {
+		imx_data->is_ddr = ddr;
+		for (i = 0; i < ARRAY_SIZE(esdhc_test_host_clocks); i++)
+			for (j = 0; j < ARRAY_SIZE(esdhc_test_sd_clocks); j++) {
+				host_clock = esdhc_test_host_clocks[i];
+				clock = esdhc_test_sd_clocks[j];
+				d = imx6q_basicdrv_calc_clock(t->host,
+					host_clock, clock);
+
+				/* SDCLKFS 0: /1, n: /(2 x n); DVS n: /(n + 1) */
+				pre_div = d->pre_div ? d->pre_div << 1 : 1;
+				div = d->div + 1;
+				KUNIT_EXPECT_LE(test, d->actual, clock);
+				KUNIT_EXPECT_EQ(test, d->actual, host_clock /
+					(pre_div * div * (ddr ? 2 : 1)));
+				KUNIT_EXPECT_EQ(test, d->clock, clock);
+				KUNIT_EXPECT_EQ(test, d->host_clock, host_clock);
+			}
+	}
+	esdhc_test_cost(test, 0, 0);
+}
+
+/*
+ * The PER clock notifier re-programs the divider for the new rate,
+ * slower after the change, faster before it. Cached dividers belong
+ * to the host clock they were computed for and are not reused.
+ */
+static void esdhc_test_clk_notifier(struct kunit *test)
+{
+	struct esdhc_test *t = test->priv;
+	struct pltfm_imx_data *imx_data = esdhc_priv(t->host);
+	struct clk_notifier_data cnd = {
+		.old_rate = ESDHC_TEST_HOST_CLOCK,
+		.new_rate = ESDHC_TEST_HOST_CLOCK / 2,
+	};
+	struct notifier_block *nb = &imx_data->clk_nb;
+
+	t->host->clock = 50000000;
+	imx6q_basicdrv_set_clock(t->host, t->host->clock);
+	KUNIT_EXPECT_EQ(test, esdhc_test_reg(t, ESDHC_SYSTEM_CONTROL) &
+		ESDHC_CLOCK_MASK, (u32)3 << ESDHC_DIVIDER_SHIFT);
+
+	KUNIT_EXPECT_EQ(test, imx6q_basicdrv_clk_notifier(nb,
+		PRE_RATE_CHANGE, &cnd), NOTIFY_OK);
+	KUNIT_EXPECT_EQ(test, esdhc_test_reg(t, ESDHC_SYSTEM_CONTROL) &
+		ESDHC_CLOCK_MASK, (u32)3 << ESDHC_DIVIDER_SHIFT);
+
+	/* 99 MHz / 2 */
+	imx6q_basicdrv_clk_notifier(nb, POST_RATE_CHANGE, &cnd);
+	KUNIT_EXPECT_EQ(test, esdhc_test_reg(t, ESDHC_SYSTEM_CONTROL) &
+		ESDHC_CLOCK_MASK, (u32)1 << ESDHC_DIVIDER_SHIFT);
+	KUNIT_EXPECT_EQ(test, t->host->mmc->actual_clock, 49500000U);
+	KUNIT_EXPECT_EQ(test, t->host->max_clk, ESDHC_TEST_HOST_CLOCK / 2);
+
+	/* and back up: applied before the rate changes */
+	cnd.old_rate = ESDHC_TEST_HOST_CLOCK / 2;
+	cnd.new_rate = ESDHC_TEST_HOST_CLOCK;
+	imx6q_basicdrv_clk_notifier(nb, PRE_RATE_CHANGE, &cnd);
+	KUNIT_EXPECT_EQ(test, esdhc_test_reg(t, ESDHC_SYSTEM_CONTROL) &
+		ESDHC_CLOCK_MASK, (u32)3 << ESDHC_DIVIDER_SHIFT);
+	KUNIT_EXPECT_EQ(test, t->host->mmc->actual_clock, 49500000U);
+}
+
+/*
+ * Cost of one sdhci_readl()/sdhci_writew(), averaged over the loop:
+ * get_cycles() where the arch has a cycle counter (it is 0 on 32-bit
+ * arm), and the time in ps from ktime_get().
+ */
+static void esdhc_test_bench_one(struct kunit *test, const char *name,
+	int reg, bool write)
+{
+	struct esdhc_test *t = test->priv;
+	cycles_t cycles;
+	ktime_t start;
+	int i;
+
+	start = ktime_get();
+	cycles = get_cycles();
+	for (i = 0; i < ESDHC_TEST_BENCH_LOOPS; i++) {
+		if (write)
+			sdhci_writew(t->host, SDHCI_TRNS_READ, reg);
+		else
+			sdhci_readl(t->host, reg);
+	}
+	cycles = get_cycles() - cycles;
+
+	kunit_info(test, "%s: %lu cycles, %llu ps\n", name,
+		(unsigned long)cycles / ESDHC_TEST_BENCH_LOOPS,
+		div_u64(ktime_to_ns(ktime_sub(ktime_get(), start)) * 1000,
+			ESDHC_TEST_BENCH_LOOPS));
+}
+
+/*
+ * Cost of the accessor dispatch. Report only: the numbers depend on the
+ * CPU (and on QEMU), there is nothing to assert. "std" is what a spec
+ * compliant host pays (sdhci_basicdrv_std_ops, no read_l), the others go
+ * through the uSDHC translation, with and without the MMIO accounting
+ * key.
+ */
+static void esdhc_test_bench(struct kunit *test)
+{
+	struct esdhc_test *t = test->priv;
+
+	t->host->ops = &sdhci_basicdrv_std_ops;
+	esdhc_test_bench_one(test, "std   readl INT_STATUS",
+		SDHCI_INT_STATUS, false);
+	t->host->ops = &t->ops;
+
+	esdhc_test_bench_one(test, "usdhc readl INT_STATUS",
+		SDHCI_INT_STATUS, false);
+	esdhc_test_bench_one(test, "usdhc writew TRANSFER_MODE",
+		SDHCI_TRANSFER_MODE, true);
+
+	if (!IS_ENABLED(CONFIG_DEBUG_FS))
+		return;
+
+	imx6q_basicdrv_op_cost_enable(t->host, true);
+	esdhc_test_bench_one(test, "usdhc readl INT_STATUS, op costs on",
+		SDHCI_INT_STATUS, false);
+	esdhc_test_bench_one(test, "usdhc writew TRANSFER_MODE, op costs on",
+		SDHCI_TRANSFER_MODE, true);
+	imx6q_basicdrv_op_cost_enable(t->host, false);
+}
+
+static struct kunit_case esdhc_test_cases[] = {
+	KUNIT_CASE(esdhc_test_int_adma_error),
+	KUNIT_CASE(esdhc_test_int_held),
+	KUNIT_CASE(esdhc_test_int_coalesce),
+	KUNIT_CASE(esdhc_test_present_state),
+	KUNIT_CASE(esdhc_test_caps),
+	KUNIT_CASE(esdhc_test_cmd_issue),
+	KUNIT_CASE(esdhc_test_host_control),
+	KUNIT_CASE(esdhc_test_host_control2),
+	KUNIT_CASE(esdhc_test_clrset),
+	KUNIT_CASE(esdhc_test_reset_all),
+	KUNIT_CASE(esdhc_test_reset),
+	KUNIT_CASE(esdhc_test_max_min_clock),
+	KUNIT_CASE(esdhc_test_set_clock),
+	KUNIT_CASE(esdhc_test_set_timeout),
+	KUNIT_CASE(esdhc_test_set_uhs_signaling),
+	KUNIT_CASE(esdhc_test_calc_clock),
+	KUNIT_CASE(esdhc_test_clk_notifier),
+	KUNIT_CASE(esdhc_test_bench),
+	{}
+};
+
+static struct kunit_suite esdhc_test_suite = {
+	.name = "sdhci-of-basicdrv",
+	.init = esdhc_test_init,
+	.test_cases = esdhc_test_cases,
+};
+kunit_test_suite(esdhc_test_suite);
@@ -0,0 +1,144 @@
+/* SPDX-License-Identifier: GPL-2.0 */
+/*
+ * Tracepoints of the i.MX6QP Basic Driver
+ *
+ * Copyright (c) 2018  alamy.liu@gmail.com
+ */
+
+#undef TRACE_SYSTEM
+#define TRACE_SYSTEM basicdrv
+
+#if !defined(_TRACE_BASICDRV_H) || defined(TRACE_HEADER_MULTI_READ)
+#define _TRACE_BASICDRV_H
+
+#include <linux/mmc/host.h>
+#include <linux/tracepoint.h>
+
+/*
+ * Register access, width in bytes.
+ * basicdrv_read/write:      SDHCI register and value, as seen by sdhci.c
+ * basicdrv_mmio_read/write: uSDHC register and value on the bus
+ */
+DECLARE_EVENT_CLASS(basicdrv_reg,
+
+	TP_PROTO(struct sdhci_host *host, int reg, u32 val, int width),
+
+	TP_ARGS(host, reg, val, width),
+
+	TP_STRUCT__entry(
+		__string(name, mmc_hostname(host->mmc))
+		__field(int, reg)
+		__field(u32, val)
+		__field(int, width)
+	),
+
+	TP_fast_assign(
+		__assign_str(name, mmc_hostname(host->mmc));
+		__entry->reg = reg;
+		__entry->val = val;
+		__entry->width = width;
+	),
+
+	TP_printk("%s: 0x%02x/%d 0x%08x",
+		__get_str(name), __entry->reg, __entry->width, __entry->val)
+);
+
+DEFINE_EVENT(basicdrv_reg, basicdrv_read,
+	TP_PROTO(struct sdhci_host *host, int reg, u32 val, int width),
+	TP_ARGS(host, reg, val, width)
+);
+
+DEFINE_EVENT(basicdrv_reg, basicdrv_write,
+	TP_PROTO(struct sdhci_host *host, int reg, u32 val, int width),
+	TP_ARGS(host, reg, val, width)
+);
+
+DEFINE_EVENT(basicdrv_reg, basicdrv_mmio_read,
+	TP_PROTO(struct sdhci_host *host, int reg, u32 val, int width),
+	TP_ARGS(host, reg, val, width)
+);
+
+DEFINE_EVENT(basicdrv_reg, basicdrv_mmio_write,
+	TP_PROTO(struct sdhci_host *host, int reg, u32 val, int width),
+	TP_ARGS(host, reg, val, width)
+);
+
+/* Request stages: command issue, interrupt, data complete */
+TRACE_EVENT(basicdrv_cmd,
+
+	TP_PROTO(struct sdhci_host *host, struct mmc_command *cmd),
+
+	TP_ARGS(host, cmd),
+
+	TP_STRUCT__entry(
+		__string(name, mmc_hostname(host->mmc))
+		__field(u32, opcode)
+		__field(u32, arg)
+		__field(unsigned int, blocks)
+		__field(unsigned int, blksz)
+	),
+
+	TP_fast_assign(
+		__assign_str(name, mmc_hostname(host->mmc));
+		__entry->opcode = cmd->opcode;
+		__entry->arg = cmd->arg;
+		__entry->blocks = cmd->data ? cmd->data->blocks : 0;
+		__entry->blksz = cmd->data ? cmd->data->blksz : 0;
+	),
+
+	TP_printk("%s: CMD%u arg 0x%08x %ux%u",
+		__get_str(name), __entry->opcode, __entry->arg,
+		__entry->blocks, __entry->blksz)
+);
+
+TRACE_EVENT(basicdrv_irq,
+
+	TP_PROTO(struct sdhci_host *host, u32 intmask),
+
+	TP_ARGS(host, intmask),
+
+	TP_STRUCT__entry(
+		__string(name, mmc_hostname(host->mmc))
+		__field(u32, intmask)
+	),
+
+	TP_fast_assign(
+		__assign_str(name, mmc_hostname(host->mmc));
+		__entry->intmask = intmask;
+	),
+
+	TP_printk("%s: intmask 0x%08x", __get_str(name), __entry->intmask)
+);
+
+TRACE_EVENT(basicdrv_data_done,
+
+	TP_PROTO(struct sdhci_host *host, unsigned int bytes, bool read, s64 us),
+
+	TP_ARGS(host, bytes, read, us),
+
+	TP_STRUCT__entry(
+		__string(name, mmc_hostname(host->mmc))
+		__field(unsigned int, bytes)
+		__field(bool, read)
+		__field(s64, us)
+	),
+
+	TP_fast_assign(
+		__assign_str(name, mmc_hostname(host->mmc));
+		__entry->bytes = bytes;
+		__entry->read = read;
+		__entry->us = us;
+	),
+
+	TP_printk("%s: %s %u bytes in %lld us", __get_str(name),
+		__entry->read ? "read" : "write", __entry->bytes, __entry->us)
+);
+
+#endif /* _TRACE_BASICDRV_H */
+
+/* This part must be outside protection */
+#undef TRACE_INCLUDE_PATH
+#define TRACE_INCLUDE_PATH .
+#undef TRACE_INCLUDE_FILE
+#define TRACE_INCLUDE_FILE sdhci-of-basicdrv-trace
+#include <trace/define_trace.h>
@@ -6,6 +6,19 @@
  */
 
 #include <linux/module.h>
+#include <linux/bitmap.h>
+#include <linux/clk.h>
+#include <linux/debugfs.h>
+#include <linux/hrtimer.h>
+#include <linux/jump_label.h>
+#include <linux/of.h>
+#include <linux/of_device.h>
+#include <linux/percpu.h>
+#include <linux/seq_file.h>
+#include <linux/sizes.h>
+#include <linux/slab.h>
+#include <linux/string.h>
+#include <linux/version.h>
 #include <linux/mmc/host.h>
 #ifdef CONFIG_MMC_SDHCI_IO_ACCESSORS
 #include <linux/mmc/mmc.h>
@@ -13,18 +26,20 @@
 #include <linux/mmc/slot-gpio.h>
 #include <linux/pinctrl/consumer.h>
 
-/*
-#include <linux/of_device.h>
-*/
 #include "sdhci-pltfm.h"
+#include "cqhci.h"
 
 
 /********************************************************************
  * i.MX6QP related code
  ********************************************************************/
 #include <linux/delay.h>
+#include <linux/ktime.h>
 #include "sdhci-esdhc.h"
 
+#define CREATE_TRACE_POINTS
+#include "sdhci-of-basicdrv-trace.h"
+
 #ifdef CONFIG_MMC_SDHCI_IO_ACCESSORS
 /*
  * There is an INT DMA ERR mismatch between eSDHC and STD SDHC SPEC:
@@ -55,12 +70,28 @@
 /* HWInit */
 #define ESDHC_WTMK_LVL			0x44
 #define  ESDHC_WTMK_DEFAULT_VAL		0x10401040
+#define  ESDHC_WTMK_LVL_RD_WML_SHIFT	0
+#define  ESDHC_WTMK_LVL_RD_BRST_SHIFT	8
+#define  ESDHC_WTMK_LVL_WR_WML_SHIFT	16
+#define  ESDHC_WTMK_LVL_WR_BRST_SHIFT	24
+#define  ESDHC_WTMK_LVL_WML_MASK	0xff	/* words */
+#define  ESDHC_WTMK_LVL_BRST_MASK	0x1f	/* words */
 #define ESDHC_BURST_LEN_EN_INCR		(1 << 27)
 /* dll control register */
 #define ESDHC_DLL_CTRL			0x60
 #define ESDHC_DLL_OVERRIDE_VAL_SHIFT	9
 #define ESDHC_DLL_OVERRIDE_EN_SHIFT	8
 
+/* strobe dll register (HS400) */
+#define ESDHC_STROBE_DLL_CTRL		0x70
+#define ESDHC_STROBE_DLL_CTRL_ENABLE	(1 << 0)
+#define ESDHC_STROBE_DLL_CTRL_RESET	(1 << 1)
+#define ESDHC_STROBE_DLL_CTRL_SLV_DLY_TARGET_SHIFT	3
+#define ESDHC_STROBE_DLL_STATUS		0x74
+#define ESDHC_STROBE_DLL_STS_REF_LOCK	(1 << 1)
+#define ESDHC_STROBE_DLL_STS_SLV_LOCK	0x1
+#define ESDHC_STROBE_DLL_CLK_FREQ	100000000
+
 /* VENDOR SPEC register */
 #define	ESDHC_VENDOR_SPEC		(0xc0)
 #define	ESDHC_VENDOR_SPEC_SDIO_QUIRK	(1 << 1)
@@ -69,40 +100,506 @@
 
 /* Timeout */
 #define ESDHC_SYS_CTRL_DTOCV_MASK	0x0f
+#define  ESDHC_SYS_CTRL_DTOCV_MAX	0x0f
+#define  ESDHC_DTOCV_COUNT_SHIFT	14	/* DTOCV n: SDCLK x 2^(n + 14) */
+#define  ESDHC_DATA_TIMEOUT_MARGIN	100	/* percent added to the card's data/busy timeout */
+/* Self-clearing SYSCTL bits (RSTA, RSTC, RSTD, INITA), never shadowed */
+#define ESDHC_SYS_CTRL_RST_MASK		0x0f000000
+
+/* Error recovery */
+#define ESDHC_INT_RECOVER_MASK		(SDHCI_INT_TIMEOUT | SDHCI_INT_CRC | \
+					 SDHCI_INT_END_BIT | SDHCI_INT_INDEX | \
+					 SDHCI_INT_DATA_TIMEOUT | \
+					 SDHCI_INT_DATA_CRC | \
+					 SDHCI_INT_DATA_END_BIT)
+/* errors in a row (no good transfer in between) before a re-tune */
+#define ESDHC_ERR_RETUNE_THRESHOLD	3
+
+/* Interrupt coalescing budget limit */
+#define ESDHC_IRQ_COALESCE_MAX_US	1000
+
+/* Polled completion: spin budget */
+#define ESDHC_POLL_US_DEFAULT		20
+#define ESDHC_POLL_MAX_US		100
+
+/* SD clock: remembered divider settings, stable poll */
+#define ESDHC_CLK_CACHE_SIZE		4
+#define ESDHC_CLK_STABLE_TIMEOUT_US	1000
+#define ESDHC_CLOCK_EN_MASK		(ESDHC_CLOCK_IPGEN | ESDHC_CLOCK_HCKEN \
+					| ESDHC_CLOCK_PEREN)
+
+/* pinctrl states for the UHS timings (drive strength) */
+#define ESDHC_PINCTRL_STATE_100MHZ	"state_100mhz"
+#define ESDHC_PINCTRL_STATE_200MHZ	"state_200mhz"
+
+/*
+ * Longest ADMA2 descriptor: length 0 means 64 KiB in the spec but the
+ * uSDHC cannot do it (SDHCI_QUIRK_BROKEN_ADMA_ZEROLEN_DESC).
+ */
+#define ESDHC_ADMA2_MAX_LEN		65535
+
+/* Command Queue Engine register block */
+#define ESDHC_CQHCI_ADDR_OFFSET		0x100
 
 /* tune control register */
 #define ESDHC_TUNE_CTRL_STATUS		0x68
 #define  ESDHC_TUNE_CTRL_STEP		1
 #define  ESDHC_TUNE_CTRL_MIN		0
 #define  ESDHC_TUNE_CTRL_MAX		((1 << 7) - 1)
+#define  ESDHC_TUNE_CTRL_NUM		(ESDHC_TUNE_CTRL_MAX + 1)
+/* coarse scan stride, the fine search runs inside one stride */
+#define  ESDHC_TUNE_CTRL_COARSE_STEP	8
+/* how long to wait for the card to go idle between tuning commands */
+#define  ESDHC_TUNE_IDLE_TIMEOUT_US	1000
+/* PRSSTAT DLSL: DAT0 level, held low by the card while it is busy */
+#define  ESDHC_PRSSTAT_DAT0_LVL		BIT(24)
+/* re-tuning only looks this many taps around the current one */
+#define  ESDHC_TUNE_RETUNE_RANGE	8
+/* number of remembered tuning results (card CID + timing + clock) */
+#define  ESDHC_TUNE_CACHE_SIZE		4
+
+
+/*
+ * Per-SoC capabilities (of_device_id.data)
+ *   ESDHC_FLAG_USDHC:      uSDHC register layout, translating accessors.
+ *                          Without it the controller is spec compliant and
+ *                          runs on the standard sdhci ops (no accessors).
+ *   ESDHC_FLAG_MAN_TUNING: manual tuning (platform_execute_tuning)
+ *   ESDHC_FLAG_HS200:      HS200 is usable (otherwise SDHCI_QUIRK2_BROKEN_HS200)
+ *   ESDHC_FLAG_HS400:      HS400, strobe DLL present
+ */
+#define ESDHC_FLAG_USDHC		BIT(0)
+#define ESDHC_FLAG_MAN_TUNING		BIT(1)
+#define ESDHC_FLAG_HS200		BIT(2)
+#define ESDHC_FLAG_HS400		BIT(3)
+
+struct esdhc_soc_data {
+	u32 flags;
+	const struct sdhci_pltfm_data *pdata;
+};
+
+/*
+ * Transfer engine of a spec compliant host, "virtualcom,dma-mode" in DT
+ * or the dma_mode module parameter (all such hosts). sdhci_setup_host()
+ * picks the best engine the caps allow, quirks take the others away.
+ * ADMA tables, DMA mask and max_segs are sized there, so the engine can
+ * not change afterwards.
+ */
+enum basicdrv_dma {
+	BASICDRV_DMA_AUTO,
+	BASICDRV_DMA_PIO,
+	BASICDRV_DMA_SDMA,
+	BASICDRV_DMA_ADMA32,
+	BASICDRV_DMA_ADMA64,
+};
+
+static const char * const basicdrv_dma_names[] = {
+	[BASICDRV_DMA_AUTO]	= "auto",
+	[BASICDRV_DMA_PIO]	= "pio",
+	[BASICDRV_DMA_SDMA]	= "sdma",
+	[BASICDRV_DMA_ADMA32]	= "adma32",
+	[BASICDRV_DMA_ADMA64]	= "adma64",
+};
+
+static char *dma_mode;
+module_param(dma_mode, charp, 0444);
+MODULE_PARM_DESC(dma_mode, "Spec compliant hosts: auto, pio, sdma, adma32, adma64 (overrides DT)");
+
+/* SYSCTL divider fields for one SD clock request (register encoding) */
+struct esdhc_clk_div {
+	unsigned int host_clock;
+	unsigned int clock;	/* 0: empty entry */
+	int ddr_pre_div;
+	unsigned int actual;
+	u32 pre_div;
+	u32 div;
+};
+
+/*
+ * MMIO cost of the sdhci_ops accessors: uSDHC reads/writes caused by one
+ * SDHCI register access, [0] read, [1] write, indexed by SDHCI register.
+ */
+#define ESDHC_SDHCI_REG_NUM		0x100
+
+struct esdhc_op_cost {
+	u32 calls;
+	u32 reads;
+	u32 writes;
+};
+
+/*
+ * Enabled while any host has basicdrv_mmio_ops_enable set (counted),
+ * so the accounting is a NOP in every accessor until then.
+ */
+static DEFINE_STATIC_KEY_FALSE(esdhc_op_cost_key);
+
+/*
+ * Request statistics. Per CPU, updated without locks or atomics from
+ * the command issue and interrupt paths, summed up by debugfs.
+ * Latency (command issue -> transfer complete) is a log2 histogram:
+ * bucket 0 is < 1 us, bucket n is [2^(n-1), 2^n) us.
+ */
+#define ESDHC_HIST_BUCKETS		24
+
+enum esdhc_size_class {
+	ESDHC_SIZE_512,			/* <= 512 bytes */
+	ESDHC_SIZE_4K,
+	ESDHC_SIZE_64K,
+	ESDHC_SIZE_BIG,
+	ESDHC_SIZE_CLASSES,
+};
+
+struct esdhc_stats {
+	u64 requests;
+	u64 irqs;
+	u64 bytes[2];			/* [0] write, [1] read */
+	u64 hist[2][ESDHC_SIZE_CLASSES][ESDHC_HIST_BUCKETS];
+};
+
+/*
+ * Tuning algorithm, selected by the "virtualcom,tuning-mode" DT property
+ *   "fast":   coarse-to-fine search of the first passing window (default)
+ *   "robust": full pass/fail eye map, center of the widest window
+ */
+enum esdhc_tune_mode {
+	ESDHC_TUNE_FAST,
+	ESDHC_TUNE_ROBUST,
+};
+
+/*
+ * Last good delay tap of a card in one timing mode/clock.
+ * An entry stored during card init (mmc->card not attached yet) gets the
+ * CID at the next lookup. A wrong guess only costs one tuning command,
+ * a cached tap is always validated before use.
+ */
+struct esdhc_tune_cache {
+	u32 cid[4];
+	bool cid_pending;
+	unsigned char timing;
+	unsigned int clock;	/* 0: empty entry */
+	int tap;
+};
+
+/*
+ * Per-host private data (sdhci_pltfm_priv)
+ *
+ * MIX_CTRL, VENDOR_SPEC, SYSCTL and TUNE_CTRL_STATUS are owned by this
+ * driver: the hardware does not change them behind our back (except
+ * SYSCTL on RESET_ALL, see esdhc_writeb). Keep a shadow copy of each so
+ * the accessors do not need a read-back before every write. On the
+ * command issue path this turns every read-modify-write into one posted
+ * write.
+ */
+struct pltfm_imx_data {
+	struct sdhci_host *host;
+	const struct esdhc_soc_data *socdata;
+
+	/* PER is pltfm_host->clk, its rate is pltfm_host->clock */
+	struct clk *clk_ipg;
+	struct clk *clk_ahb;
+	struct notifier_block clk_nb;
+
+	struct pinctrl *pinctrl;
+	struct pinctrl_state *pins_default;
+	struct pinctrl_state *pins_100mhz;
+	struct pinctrl_state *pins_200mhz;
+
+	struct esdhc_clk_div clk_div[ESDHC_CLK_CACHE_SIZE];
+	int clk_div_next;
+
+	bool is_ddr;		/* DDR50/DDR52/HS400: SD clock is divided by 2 */
+	u32 delay_line;		/* DLL override for DDR modes, 0: off */
+
+	/* Shadow registers */
+	u32 mix_ctrl;
+	u32 vendor_spec;
+	u32 sys_ctrl;
+	u32 tune_ctrl;
+
+	/* MMIO statistics */
+	u64 mmio_reads;
+	u64 mmio_writes;
+	u64 cmd_count;
+	struct esdhc_op_cost op_cost[2][ESDHC_SDHCI_REG_NUM];
+	bool op_cost_on;	/* debugfs basicdrv_mmio_ops_enable */
+
+	/* Request statistics */
+	struct esdhc_stats __percpu *stats;
+	ktime_t req_start;
+	unsigned int req_bytes;	/* data command in flight, 0: none */
+	bool req_read;
+	u64 timeouts;
+
+	/* ADMA2 descriptor builder */
+	dma_addr_t adma_next;	/* end of the last data descriptor */
+	u64 adma_tables;
+	u64 adma_descs;
+	u64 adma_merged;
+
+	bool has_cqe;		/* "supports-cqe" in DT */
+
+	/* Data timeout, DT/debugfs */
+	u32 data_timeout_ms;	/* fixed timeout, 0: from the card (CSD) */
+	u32 data_timeout_margin;	/* percent */
+	u8 dtocv;		/* last value programmed */
+
+	/* Error recovery, see imx6q_basicdrv_reset() */
+	bool tuning;		/* errors are expected, do not count them */
+	u32 err_streak;
+	ktime_t err_time;	/* last CRC/timeout interrupt */
+	u64 errors;
+	u64 line_resets;
+	u64 full_resets;
+	u64 err_retunes;
+	u64 recovery_ns;	/* error interrupt -> line reset done */
+	u64 recovery_ns_max;
+	u32 inject_crc;		/* debugfs: fail the next n transfers */
+
+	/* Interrupt coalescing, see imx6q_basicdrv_irq_coalesce() */
+	u32 irq_coalesce_us;	/* DT/debugfs, 0: off */
+	u32 irq_held;		/* masked in SIGNAL_ENABLE, hidden in INT_STATUS */
+	bool irq_flush;		/* window closed, process the next interrupt */
+	struct hrtimer irq_timer;
+	u64 irq_windows;
+
+	/* Polled completion, see imx6q_basicdrv_request() */
+	u32 poll_max_bytes;	/* DT/debugfs, 0: off */
+	u32 poll_us;		/* DT/debugfs, spin budget */
+	void (*sdhci_request)(struct mmc_host *mmc, struct mmc_request *mrq);
+	u32 req_seq;		/* data transfers completed or failed */
+	u64 poll_hits;
+	u64 poll_misses;
+	u32 wtmk_lvl;		/* ESDHC_WTMK_LVL, DT/debugfs */
+
+	enum esdhc_tune_mode tune_mode;
+	/* pass/fail of every tap, filled in ESDHC_TUNE_ROBUST mode */
+	DECLARE_BITMAP(tune_map, ESDHC_TUNE_CTRL_NUM);
+
+	struct esdhc_tune_cache tune_cache[ESDHC_TUNE_CACHE_SIZE];
+	int tune_cache_next;
+
+	/* Tuning statistics (last tuning + total) */
+	u32 tune_cmds;		/* CMD19/CMD21 issued */
+	u32 tune_time_us;
+	int tune_tap;
+	u64 tune_count;
+	u64 tune_cache_hits;
+	u64 retune_count;
+	int retune_drift;	/* tap change of the last re-tune */
+	int retune_drift_max;	/* largest |drift| seen */
+
+	/* Spec compliant hosts only (no ESDHC_FLAG_USDHC) */
+	enum basicdrv_dma dma;	/* requested transfer engine */
+	u64 dma_irqs;		/* SDMA boundary (SDHCI_INT_DMA_END) */
+	u64 data_irqs;		/* transfer complete */
+};
+
+static inline struct pltfm_imx_data *esdhc_priv(struct sdhci_host *host)
+{
+	struct sdhci_pltfm_host *pltfm_host = sdhci_priv(host);
+
+	return sdhci_pltfm_priv(pltfm_host);
+}
+
+/* Raw (counted) MMIO helpers, use these instead of readl/writel */
+static inline u32 esdhc_mmio_readl(struct sdhci_host *host, int reg)
+{
+	u32 val = readl(host->ioaddr + reg);
+
+	esdhc_priv(host)->mmio_reads++;
+	trace_basicdrv_mmio_read(host, reg, val, 4);
+	return val;
+}
+
+static inline u16 esdhc_mmio_readw(struct sdhci_host *host, int reg)
+{
+	u16 val = readw(host->ioaddr + reg);
+
+	esdhc_priv(host)->mmio_reads++;
+	trace_basicdrv_mmio_read(host, reg, val, 2);
+	return val;
+}
+
+static inline u8 esdhc_mmio_readb(struct sdhci_host *host, int reg)
+{
+	u8 val = readb(host->ioaddr + reg);
+
+	esdhc_priv(host)->mmio_reads++;
+	trace_basicdrv_mmio_read(host, reg, val, 1);
+	return val;
+}
+
+static inline void esdhc_mmio_writel(struct sdhci_host *host, u32 val, int reg)
+{
+	esdhc_priv(host)->mmio_writes++;
+	trace_basicdrv_mmio_write(host, reg, val, 4);
+	writel(val, host->ioaddr + reg);
+}
+
+/* Shadowed register writers */
+static inline void esdhc_write_mix_ctrl(struct sdhci_host *host, u32 val)
+{
+	esdhc_priv(host)->mix_ctrl = val;
+	esdhc_mmio_writel(host, val, ESDHC_MIX_CTRL);
+}
+
+static inline void esdhc_write_vendor_spec(struct sdhci_host *host, u32 val)
+{
+	esdhc_priv(host)->vendor_spec = val;
+	esdhc_mmio_writel(host, val, ESDHC_VENDOR_SPEC);
+}
 
+static inline void esdhc_write_sys_ctrl(struct sdhci_host *host, u32 val)
+{
+	esdhc_priv(host)->sys_ctrl = val & ~ESDHC_SYS_CTRL_RST_MASK;
+	esdhc_mmio_writel(host, val, ESDHC_SYSTEM_CONTROL);
+}
+
+static inline void esdhc_write_tune_ctrl(struct sdhci_host *host, u32 val)
+{
+	esdhc_priv(host)->tune_ctrl = val;
+	esdhc_mmio_writel(host, val, ESDHC_TUNE_CTRL_STATUS);
+}
+
+/* Reload the shadow registers from hardware (probe, RESET_ALL) */
+static void esdhc_sync_shadow(struct sdhci_host *host)
+{
+	struct pltfm_imx_data *imx_data = esdhc_priv(host);
+
+	imx_data->mix_ctrl = esdhc_mmio_readl(host, ESDHC_MIX_CTRL);
+	imx_data->vendor_spec = esdhc_mmio_readl(host, ESDHC_VENDOR_SPEC);
+	imx_data->sys_ctrl = esdhc_mmio_readl(host, ESDHC_SYSTEM_CONTROL)
+				& ~ESDHC_SYS_CTRL_RST_MASK;
+	imx_data->tune_ctrl = esdhc_mmio_readl(host, ESDHC_TUNE_CTRL_STATUS);
+}
 
 static inline void esdhc_clrset(struct sdhci_host *host, u32 mask, u32 val, int reg)
 {
 	int reg_ofst = (reg & ~0x3);
 	u32 reg_shft = (reg & 0x3) * 8;
 
+	if (reg_ofst == ESDHC_SYSTEM_CONTROL) {
+		/* SYSCTL is shadowed, no read-back needed */
+		esdhc_write_sys_ctrl(host,
+			(esdhc_priv(host)->sys_ctrl & ~(mask << reg_shft))
+			| (val << reg_shft));
+		return;
+	}
+
 	sdhci_writel(host,
 		(sdhci_readl(host, reg_ofst) & ~(mask << reg_shft)) | (val << reg_shft),
 		reg_ofst);
 }
 
+/*
+ * RESET_ALL has completed (RSTA self-cleared), called from the .reset
+ * hook once sdhci_reset() returns. Resyncing any earlier would read
+ * the registers mid-reset.
+ */
+static void esdhc_reset_all_done(struct sdhci_host *host)
+{
+	/*
+	 * RESET_ALL is the only thing that changes the shadowed
+	 * registers behind our back. Reload them (slow path) before
+	 * touching SYSCTL again.
+	 */
+	esdhc_sync_shadow(host);
+
+	/*
+	 * The esdhc has a design violation to SDHC spec which tells that
+	 * software reset should not affect card detection circuit. But
+	 * esdhc clears its SYSCTL register bits [0..2] during the software
+	 * reset. This will stop those clocks that card detection circuit
+	 * relies on. To work around it, we turn the clocks on back to keep
+	 * card detection circuit functional.
+	 */
+	esdhc_clrset(host, 0x7, 0x7, ESDHC_SYSTEM_CONTROL);
+
+	/*
+	 * The reset on usdhc fails to clear MIX_CTRL register.
+	 * Do it manually here, the tuning bits should be kept.
+	 */
+	esdhc_write_mix_ctrl(host,
+		esdhc_priv(host)->mix_ctrl & ESDHC_MIX_CTRL_TUNING_MASK);
+
+	/* back to the power-on default, keep the DT/debugfs value */
+	esdhc_mmio_writel(host, esdhc_priv(host)->wtmk_lvl, ESDHC_WTMK_LVL);
+}
+
+static inline enum esdhc_size_class esdhc_size_class(unsigned int bytes)
+{
+	if (bytes <= 512)
+		return ESDHC_SIZE_512;
+	if (bytes <= SZ_4K)
+		return ESDHC_SIZE_4K;
+	if (bytes <= SZ_64K)
+		return ESDHC_SIZE_64K;
+	return ESDHC_SIZE_BIG;
+}
+
+/* SDHCI_COMMAND write: host->cmd is the command being issued */
+static inline void esdhc_stats_start(struct sdhci_host *host)
+{
+	struct pltfm_imx_data *imx_data = esdhc_priv(host);
+	struct mmc_data *data = host->cmd->data;
+
+	if (!data)
+		return;
+
+	imx_data->req_start = ktime_get();
+	imx_data->req_bytes = data->blksz * data->blocks;
+	imx_data->req_read = !!(data->flags & MMC_DATA_READ);
+}
+
+/* Transfer complete without error */
+static inline void esdhc_stats_done(struct sdhci_host *host)
+{
+	struct pltfm_imx_data *imx_data = esdhc_priv(host);
+	struct esdhc_stats __percpu *stats = imx_data->stats;
+	unsigned int bytes = imx_data->req_bytes;
+	int dir = imx_data->req_read;
+	s64 us;
+	int bucket;
+
+	if (!bytes)
+		return;
+	imx_data->req_bytes = 0;
+
+	us = ktime_us_delta(ktime_get(), imx_data->req_start);
+	bucket = us > 0 ? min(ilog2(us) + 1, ESDHC_HIST_BUCKETS - 1) : 0;
+
+	this_cpu_inc(stats->requests);
+	this_cpu_add(stats->bytes[dir], bytes);
+	this_cpu_inc(stats->hist[dir][esdhc_size_class(bytes)][bucket]);
+	trace_basicdrv_data_done(host, bytes, dir, us);
+}
+
 #ifdef CONFIG_MMC_SDHCI_IO_ACCESSORS
-static u32 esdhc_readl(struct sdhci_host *host, int reg)
+static inline u32 __esdhc_readl(struct sdhci_host *host, int reg)
 {
-	u32 val = readl(host->ioaddr + reg);
+	u32 val;
 
-	if (unlikely(reg == SDHCI_PRESENT_STATE)) {
-		u32 fsl_prss = val;
+	switch (reg) {
+	case SDHCI_INT_STATUS:
+		val = esdhc_mmio_readl(host, reg);
+		if (val & ESDHC_INT_VENDOR_SPEC_DMA_ERR) {
+			val &= ~ESDHC_INT_VENDOR_SPEC_DMA_ERR;
+			val |= SDHCI_INT_ADMA_ERROR;
+		}
+		/* completions waiting for the coalescing window */
+		return val & ~esdhc_priv(host)->irq_held;
+	case SDHCI_PRESENT_STATE: {
+		u32 fsl_prss = esdhc_mmio_readl(host, reg);
 		/* save the least 20 bits */
 		val = fsl_prss & 0x000FFFFF;
 		/* move dat[0-3] bits */
 		val |= (fsl_prss & 0x0F000000) >> 4;
 		/* move cmd line bit */
 		val |= (fsl_prss & 0x00800000) << 1;
+		return val;
 	}
-
-	if (unlikely(reg == SDHCI_CAPABILITIES)) {
+	case SDHCI_CAPABILITIES:
+		val = esdhc_mmio_readl(host, reg);
 		/* In FSL esdhc IC module, only bit20 is used to indicate the
 		 * ADMA2 capability of esdhc, but this bit is messed up on
 		 * some SOCs (e.g. on MX25, MX35 this bit is set, but they
@@ -113,67 +610,61 @@ static u32 esdhc_readl(struct sdhci_host *host, int reg)
 			val &= ~SDHCI_CAN_DO_ADMA1;
 			val |= SDHCI_CAN_DO_ADMA2;
 		}
-	}
-
-	if (unlikely(reg == SDHCI_CAPABILITIES_1)) {
+		return val;
+	case SDHCI_CAPABILITIES_1:
 		/* imx6q/dl does not have cap_1 register, fake one */
-		val = SDHCI_SUPPORT_DDR50 | SDHCI_SUPPORT_SDR104
+		return SDHCI_SUPPORT_DDR50 | SDHCI_SUPPORT_SDR104
 			| SDHCI_SUPPORT_SDR50
 			| SDHCI_USE_SDR50_TUNING
 			| (SDHCI_TUNING_MODE_3 << SDHCI_RETUNING_MODE_SHIFT);
+	case SDHCI_MAX_CURRENT:
+		return (0xFF << SDHCI_MAX_CURRENT_330_SHIFT)
+			| (0xFF << SDHCI_MAX_CURRENT_300_SHIFT)
+			| (0xFF << SDHCI_MAX_CURRENT_180_SHIFT);
+	default:
+		return esdhc_mmio_readl(host, reg);
 	}
-
-	if (unlikely(reg == SDHCI_MAX_CURRENT)) {
-		val = 0;
-		val |= 0xFF << SDHCI_MAX_CURRENT_330_SHIFT;
-		val |= 0xFF << SDHCI_MAX_CURRENT_300_SHIFT;
-		val |= 0xFF << SDHCI_MAX_CURRENT_180_SHIFT;
-	}
-
-	if (unlikely(reg == SDHCI_INT_STATUS)) {
-		if (val & ESDHC_INT_VENDOR_SPEC_DMA_ERR) {
-			val &= ~ESDHC_INT_VENDOR_SPEC_DMA_ERR;
-			val |= SDHCI_INT_ADMA_ERROR;
-		}
-	}
-
-	return val;
 }
 
-static void esdhc_writel(struct sdhci_host *host, u32 val, int reg)
+static inline void __esdhc_writel(struct sdhci_host *host, u32 val, int reg)
 {
-    /* Interrupts: Bit-25 -> Bit-28 */
-	if (unlikely(reg == SDHCI_INT_ENABLE || reg == SDHCI_SIGNAL_ENABLE ||
-			reg == SDHCI_INT_STATUS)) {
+	switch (reg) {
+	case SDHCI_SIGNAL_ENABLE:
+		/* keep held completions masked until the window closes */
+		val &= ~esdhc_priv(host)->irq_held;
+		/* fall through */
+	/* Interrupts: Bit-25 -> Bit-28 */
+	case SDHCI_INT_ENABLE:
+	case SDHCI_INT_STATUS:
 		if (val & SDHCI_INT_ADMA_ERROR) {
 			val &= ~SDHCI_INT_ADMA_ERROR;
 			val |= ESDHC_INT_VENDOR_SPEC_DMA_ERR;
 		}
+		break;
 	}
 
-    writel(val, host->ioaddr + reg);
+	esdhc_mmio_writel(host, val, reg);
 }
 
-static u16 esdhc_readw(struct sdhci_host *host, int reg)
+static inline u16 __esdhc_readw(struct sdhci_host *host, int reg)
 {
+	struct pltfm_imx_data *imx_data = esdhc_priv(host);
 	u16 ret = 0;
 	u32 val;
 
-	if (unlikely(reg == SDHCI_HOST_VERSION)) {
-		reg ^= 2;
+	switch (reg) {
+	case SDHCI_HOST_VERSION:
 		/*
 		 * The usdhc register returns a wrong host version.
 		 * Correct it here.
 		 */
 		return SDHCI_SPEC_300;
-	}
-
-	if (unlikely(reg == SDHCI_HOST_CONTROL2)) {
-		val = readl(host->ioaddr + ESDHC_VENDOR_SPEC);
+	case SDHCI_HOST_CONTROL2:
+		val = imx_data->vendor_spec;
 		if (val & ESDHC_VENDOR_SPEC_VSELECT)
 			ret |= SDHCI_CTRL_VDD_180;
 
-		val = readl(host->ioaddr + ESDHC_MIX_CTRL);
+		val = imx_data->mix_ctrl;
 		if (val & ESDHC_MIX_CTRL_EXE_TUNE)
 			ret |= SDHCI_CTRL_EXEC_TUNING;
 		if (val & ESDHC_MIX_CTRL_SMPCLK_SEL)
@@ -182,44 +673,43 @@ static u16 esdhc_readw(struct sdhci_host *host, int reg)
 		ret &= ~SDHCI_CTRL_PRESET_VAL_ENABLE;
 
 		return ret;
-	}
-
-	if (unlikely(reg == SDHCI_TRANSFER_MODE)) {
-		u32 m = readl(host->ioaddr + ESDHC_MIX_CTRL);
-		ret = m & ESDHC_MIX_CTRL_SDHCI_MASK;
+	case SDHCI_TRANSFER_MODE:
+		val = imx_data->mix_ctrl;
+		ret = val & ESDHC_MIX_CTRL_SDHCI_MASK;
 		/* Swap AC23 bit */
-		if (m & ESDHC_MIX_CTRL_AC23EN) {
+		if (val & ESDHC_MIX_CTRL_AC23EN) {
 			ret &= ~ESDHC_MIX_CTRL_AC23EN;
 			ret |= SDHCI_TRNS_AUTO_CMD23;
 		}
 
 		return ret;
+	default:
+		return esdhc_mmio_readw(host, reg);
 	}
-
-	return readw(host->ioaddr + reg);
 }
 
-static void esdhc_writew(struct sdhci_host *host, u16 val, int reg)
+static inline void __esdhc_writew(struct sdhci_host *host, u16 val, int reg)
 {
+	struct pltfm_imx_data *imx_data = esdhc_priv(host);
 	u32 new_val = 0;
 
 	switch (reg) {
 	case SDHCI_CLOCK_CONTROL:
-		new_val = readl(host->ioaddr + ESDHC_VENDOR_SPEC);
+		new_val = imx_data->vendor_spec;
 		if (val & SDHCI_CLOCK_CARD_EN)
 			new_val |= ESDHC_VENDOR_SPEC_FRC_SDCLK_ON;
 		else
 			new_val &= ~ESDHC_VENDOR_SPEC_FRC_SDCLK_ON;
-		writel(new_val, host->ioaddr + ESDHC_VENDOR_SPEC);
+		esdhc_write_vendor_spec(host, new_val);
 		return;
 	case SDHCI_HOST_CONTROL2:
-		new_val = readl(host->ioaddr + ESDHC_VENDOR_SPEC);
+		new_val = imx_data->vendor_spec;
 		if (val & SDHCI_CTRL_VDD_180)
 			new_val |= ESDHC_VENDOR_SPEC_VSELECT;
 		else
 			new_val &= ~ESDHC_VENDOR_SPEC_VSELECT;
-		writel(new_val, host->ioaddr + ESDHC_VENDOR_SPEC);
-		new_val = readl(host->ioaddr + ESDHC_MIX_CTRL);
+		esdhc_write_vendor_spec(host, new_val);
+		new_val = imx_data->mix_ctrl;
 		if (val & SDHCI_CTRL_TUNED_CLK) {
 			new_val |= ESDHC_MIX_CTRL_SMPCLK_SEL;
 			new_val |= ESDHC_MIX_CTRL_AUTO_TUNE_EN;
@@ -227,25 +717,27 @@ static void esdhc_writew(struct sdhci_host *host, u16 val, int reg)
 			new_val &= ~ESDHC_MIX_CTRL_SMPCLK_SEL;
 			new_val &= ~ESDHC_MIX_CTRL_AUTO_TUNE_EN;
 		}
-		writel(new_val , host->ioaddr + ESDHC_MIX_CTRL);
+		esdhc_write_mix_ctrl(host, new_val);
 
 		return;
 	case SDHCI_TRANSFER_MODE:
-		new_val = readl(host->ioaddr + ESDHC_MIX_CTRL);
+		new_val = imx_data->mix_ctrl;
 		/* Swap AC23 bit */
 		if (val & SDHCI_TRNS_AUTO_CMD23) {
 			val &= ~SDHCI_TRNS_AUTO_CMD23;
 			val |= ESDHC_MIX_CTRL_AC23EN;
 		}
 		new_val = val | (new_val & ~ESDHC_MIX_CTRL_SDHCI_MASK);
-		writel(new_val, host->ioaddr + ESDHC_MIX_CTRL);
+		esdhc_write_mix_ctrl(host, new_val);
 		return;
 	case SDHCI_COMMAND:
 		if (host->cmd->opcode == MMC_STOP_TRANSMISSION)
 			val |= SDHCI_CMD_ABORTCMD;
 
-		writel(val << 16,
-		       host->ioaddr + SDHCI_TRANSFER_MODE);
+		imx_data->cmd_count++;
+		esdhc_stats_start(host);
+		trace_basicdrv_cmd(host, host->cmd);
+		esdhc_mmio_writel(host, val << 16, SDHCI_TRANSFER_MODE);
 		return;
 	case SDHCI_BLOCK_SIZE:
 		val &= ~SDHCI_MAKE_BLKSZ(0x7, 0);
@@ -254,14 +746,14 @@ static void esdhc_writew(struct sdhci_host *host, u16 val, int reg)
 	esdhc_clrset(host, 0xffff, val, reg);
 }
 
-static u8 esdhc_readb(struct sdhci_host *host, int reg)
+static inline u8 __esdhc_readb(struct sdhci_host *host, int reg)
 {
 	u8 ret;
 	u32 val;
 
 	switch (reg) {
 	case SDHCI_HOST_CONTROL:
-		val = readl(host->ioaddr + reg);
+		val = esdhc_mmio_readl(host, reg);
 
 		ret = val & SDHCI_CTRL_LED;
 		ret |= (val >> 5) & SDHCI_CTRL_DMA_MASK;
@@ -270,10 +762,10 @@ static u8 esdhc_readb(struct sdhci_host *host, int reg)
 		return ret;
 	}
 
-	return readb(host->ioaddr + reg);
+	return esdhc_mmio_readb(host, reg);
 }
 
-static void esdhc_writeb(struct sdhci_host *host, u8 val, int reg)
+static inline void __esdhc_writeb(struct sdhci_host *host, u8 val, int reg)
 {
 	u32 new_val = 0;
 	u32 mask;
@@ -305,52 +797,173 @@ static void esdhc_writeb(struct sdhci_host *host, u8 val, int reg)
 		return;
 	case SDHCI_SOFTWARE_RESET:
 		if (val & SDHCI_RESET_DATA)
-			new_val = readl(host->ioaddr + SDHCI_HOST_CONTROL);
+			new_val = esdhc_mmio_readl(host, SDHCI_HOST_CONTROL);
 		break;
 	}
 	esdhc_clrset(host, 0xff, val, reg);
 
-	if (reg == SDHCI_SOFTWARE_RESET) {
-		if (val & SDHCI_RESET_ALL) {
-			/*
-			 * The esdhc has a design violation to SDHC spec which
-			 * tells that software reset should not affect card
-			 * detection circuit. But esdhc clears its SYSCTL
-			 * register bits [0..2] during the software reset. This
-			 * will stop those clocks that card detection circuit
-			 * relies on. To work around it, we turn the clocks on
-			 * back to keep card detection circuit functional.
-			 */
-			esdhc_clrset(host, 0x7, 0x7, ESDHC_SYSTEM_CONTROL);
-			/*
-			 * The reset on usdhc fails to clear MIX_CTRL register.
-			 * Do it manually here.
-			 */
-			/*
-			 * the tuning bits should be kept during reset
-			 */
-			new_val = readl(host->ioaddr + ESDHC_MIX_CTRL);
-			writel(new_val & ESDHC_MIX_CTRL_TUNING_MASK,
-					host->ioaddr + ESDHC_MIX_CTRL);
-		} else if (val & SDHCI_RESET_DATA) {
-			/*
-			 * The eSDHC DAT line software reset clears at least the
-			 * data transfer width on i.MX25, so make sure that the
-			 * Host Control register is unaffected.
-			 */
-			esdhc_clrset(host, 0xff, new_val,
-					SDHCI_HOST_CONTROL);
-		}
+	/* RESET_ALL is finished off by esdhc_reset_all_done() */
+	if (reg == SDHCI_SOFTWARE_RESET && !(val & SDHCI_RESET_ALL) &&
+	    (val & SDHCI_RESET_DATA)) {
+		/*
+		 * The eSDHC DAT line software reset clears at least the
+		 * data transfer width on i.MX25, so make sure that the
+		 * Host Control register is unaffected.
+		 */
+		esdhc_clrset(host, 0xff, new_val, SDHCI_HOST_CONTROL);
 	}
 }
+
+/*
+ * MMIO counters before an accessor call, only loaded while accounting.
+ * Costs are off by default: the accessors then pay a NOP here instead
+ * of two u64 loads.
+ */
+static inline void esdhc_op_cost_start(struct sdhci_host *host,
+	u64 *reads, u64 *writes)
+{
+	struct pltfm_imx_data *imx_data;
+
+	if (!static_branch_unlikely(&esdhc_op_cost_key))
+		return;
+
+	imx_data = esdhc_priv(host);
+	*reads = imx_data->mmio_reads;
+	*writes = imx_data->mmio_writes;
+}
+
+/* Charge the MMIO done since esdhc_op_cost_start() to one accessor call */
+static inline void esdhc_op_cost(struct sdhci_host *host, int reg,
+	int write, u64 reads, u64 writes)
+{
+	struct pltfm_imx_data *imx_data = esdhc_priv(host);
+	struct esdhc_op_cost *c;
+
+	if (!static_branch_unlikely(&esdhc_op_cost_key) ||
+	    !imx_data->op_cost_on)
+		return;
+
+	c = &imx_data->op_cost[write][reg & (ESDHC_SDHCI_REG_NUM - 1)];
+	c->calls++;
+	c->reads += imx_data->mmio_reads - reads;
+	c->writes += imx_data->mmio_writes - writes;
+}
+
+/*
+ * sdhci_ops accessors: the SDHCI view of each access, the translated
+ * uSDHC accesses are traced by the esdhc_mmio_* helpers. Tracepoints
+ * are static branches, disabled they cost a NOP.
+ */
+static u32 esdhc_readl(struct sdhci_host *host, int reg)
+{
+	u64 reads, writes;
+	u32 val;
+
+	esdhc_op_cost_start(host, &reads, &writes);
+	val = __esdhc_readl(host, reg);
+	esdhc_op_cost(host, reg, 0, reads, writes);
+	trace_basicdrv_read(host, reg, val, 4);
+	return val;
+}
+
+static u16 esdhc_readw(struct sdhci_host *host, int reg)
+{
+	u64 reads, writes;
+	u16 val;
+
+	esdhc_op_cost_start(host, &reads, &writes);
+	val = __esdhc_readw(host, reg);
+	esdhc_op_cost(host, reg, 0, reads, writes);
+	trace_basicdrv_read(host, reg, val, 2);
+	return val;
+}
+
+static u8 esdhc_readb(struct sdhci_host *host, int reg)
+{
+	u64 reads, writes;
+	u8 val;
+
+	esdhc_op_cost_start(host, &reads, &writes);
+	val = __esdhc_readb(host, reg);
+	esdhc_op_cost(host, reg, 0, reads, writes);
+	trace_basicdrv_read(host, reg, val, 1);
+	return val;
+}
+
+static void esdhc_writel(struct sdhci_host *host, u32 val, int reg)
+{
+	u64 reads, writes;
+
+	trace_basicdrv_write(host, reg, val, 4);
+	esdhc_op_cost_start(host, &reads, &writes);
+	__esdhc_writel(host, val, reg);
+	esdhc_op_cost(host, reg, 1, reads, writes);
+}
+
+static void esdhc_writew(struct sdhci_host *host, u16 val, int reg)
+{
+	u64 reads, writes;
+
+	trace_basicdrv_write(host, reg, val, 2);
+	esdhc_op_cost_start(host, &reads, &writes);
+	__esdhc_writew(host, val, reg);
+	esdhc_op_cost(host, reg, 1, reads, writes);
+}
+
+static void esdhc_writeb(struct sdhci_host *host, u8 val, int reg)
+{
+	u64 reads, writes;
+
+	trace_basicdrv_write(host, reg, val, 1);
+	esdhc_op_cost_start(host, &reads, &writes);
+	__esdhc_writeb(host, val, reg);
+	esdhc_op_cost(host, reg, 1, reads, writes);
+}
 #endif
 
+/*
+ * Error recovery, cheapest first:
+ * 1. CRC/timeout error: the core resets the CMD and DATA lines. RSTC and
+ *    RSTD leave the interrupt enables, MIX_CTRL and the tuning circuit
+ *    alone, so the shadows stay valid and nothing has to be rewritten.
+ * 2. ESDHC_ERR_RETUNE_THRESHOLD errors without a good transfer in
+ *    between: the sampling point has probably drifted, ask the core to
+ *    re-tune before the next request.
+ * 3. Still failing: mmc_blk_reset() re-initializes the card, which ends
+ *    in a RESET_ALL (below) and a full tuning.
+ */
 static void imx6q_basicdrv_reset(struct sdhci_host *host, u8 mask)
 {
-	pr_debug("%s\n", mmc_hostname(host->mmc));
+	struct pltfm_imx_data *imx_data = esdhc_priv(host);
+	u64 ns;
 
 	sdhci_reset(host, mask);
 
+	if (!(mask & SDHCI_RESET_ALL)) {
+		if (imx_data->tuning)
+			return;
+
+		imx_data->line_resets++;
+		if (imx_data->err_streak) {
+			ns = ktime_to_ns(ktime_sub(ktime_get(),
+					imx_data->err_time));
+			imx_data->recovery_ns = ns;
+			if (ns > imx_data->recovery_ns_max)
+				imx_data->recovery_ns_max = ns;
+		}
+		if (imx_data->err_streak >= ESDHC_ERR_RETUNE_THRESHOLD) {
+			imx_data->err_streak = 0;
+			imx_data->err_retunes++;
+			mmc_retune_needed(host->mmc);
+		}
+		return;
+	}
+
+	esdhc_reset_all_done(host);
+
+	imx_data->full_resets++;
+	imx_data->err_streak = 0;
+
 	sdhci_writel(host, host->ier, SDHCI_INT_ENABLE);
 	sdhci_writel(host, host->ier, SDHCI_SIGNAL_ENABLE);
 }
@@ -363,59 +976,108 @@ static unsigned int imx6q_basicdrv_get_max_timeout_count(struct sdhci_host *host
 	return (1 << 29);
 }
 
+/*
+ * The mmc core fills data->timeout_ns/timeout_clks from the card's
+ * TAAC/NSAC (x R2W_FACTOR for writes, fixed limits for SD), and
+ * cmd->busy_timeout for R1b commands. The DTOCV counter restarts on
+ * every block and busy period, so it only needs to cover one of them,
+ * the core's software timer still bounds the whole request.
+ */
+static u8 imx6q_basicdrv_calc_dtocv(struct sdhci_host *host,
+	struct mmc_command *cmd)
+{
+	struct pltfm_imx_data *imx_data = esdhc_priv(host);
+	struct mmc_data *data = cmd->data;
+	unsigned int clock = host->mmc->actual_clock ?: host->clock;
+	u64 target_us, max_us, count;
+	u8 dtocv;
+
+	if (!clock)
+		return ESDHC_SYS_CTRL_DTOCV_MAX;
+
+	if (imx_data->data_timeout_ms)
+		target_us = imx_data->data_timeout_ms * 1000ULL;
+	else if (data)
+		target_us = DIV_ROUND_UP(data->timeout_ns, 1000) +
+			DIV_ROUND_UP_ULL((u64)data->timeout_clks * USEC_PER_SEC,
+				clock);
+	else if (cmd->busy_timeout)
+		target_us = cmd->busy_timeout * 1000ULL;
+	else
+		return ESDHC_SYS_CTRL_DTOCV_MAX;
+
+	/*
+	 * Anything past the longest DTOCV (SDCLK x 2^29) gets DTOCV_MAX
+	 * anyway. Clamp first so that neither the margin nor the
+	 * conversion to SD clock cycles below can overflow.
+	 */
+	max_us = DIV_ROUND_UP_ULL((1ULL << (ESDHC_SYS_CTRL_DTOCV_MAX +
+			ESDHC_DTOCV_COUNT_SHIFT)) * USEC_PER_SEC, clock);
+	target_us = min(target_us, max_us);
+	target_us += div_u64(target_us * imx_data->data_timeout_margin, 100);
+	if (target_us >= max_us)
+		return ESDHC_SYS_CTRL_DTOCV_MAX;
+
+	/* SD clock cycles */
+	count = DIV_ROUND_UP_ULL(target_us * clock, USEC_PER_SEC);
+	for (dtocv = 0; dtocv < ESDHC_SYS_CTRL_DTOCV_MAX; dtocv++)
+		if (count <= (1ULL << (dtocv + ESDHC_DTOCV_COUNT_SHIFT)))
+			break;
+
+	return dtocv;
+}
+
 static void imx6q_basicdrv_set_timeout(struct sdhci_host *host, struct mmc_command *cmd)
 {
-	pr_debug("%s\n", mmc_hostname(host->mmc));
+	struct pltfm_imx_data *imx_data = esdhc_priv(host);
+
+	imx_data->dtocv = imx6q_basicdrv_calc_dtocv(host, cmd);
 
-	/* use maximum timeout counter */
 	esdhc_clrset(host,
-			ESDHC_SYS_CTRL_DTOCV_MASK, 0xF,
+			ESDHC_SYS_CTRL_DTOCV_MASK, imx_data->dtocv,
 			SDHCI_TIMEOUT_CONTROL);
 }
 
+/* Used when the PER clock does not report its rate */
 #define IMX6Q_HOST_CLOCK		(198000000)
 
 static unsigned int imx6q_basicdrv_get_max_clock(struct sdhci_host *host)
 {
-	pr_debug("%s: max clock=%d\n", mmc_hostname(host->mmc), IMX6Q_HOST_CLOCK);
+	struct sdhci_pltfm_host *pltfm_host = sdhci_priv(host);
 
-	return IMX6Q_HOST_CLOCK;   /* Hacking */
+	pr_debug("%s: max clock=%d\n", mmc_hostname(host->mmc),
+		pltfm_host->clock);
+
+	return pltfm_host->clock;
 }
 
 static unsigned int imx6q_basicdrv_get_min_clock(struct sdhci_host *host)
 {
+	struct sdhci_pltfm_host *pltfm_host = sdhci_priv(host);
+
 	pr_debug("%s: min clock=%d\n", mmc_hostname(host->mmc),
-		IMX6Q_HOST_CLOCK / 256 / 16);
+		pltfm_host->clock / 256 / 16);
 
-	return IMX6Q_HOST_CLOCK / 256 / 16;
+	return pltfm_host->clock / 256 / 16;
 }
 
-static void imx6q_basicdrv_set_clock(
-	struct sdhci_host *host,
-	unsigned int clock)
+static struct esdhc_clk_div *imx6q_basicdrv_calc_clock(
+	struct sdhci_host *host, unsigned int host_clock, unsigned int clock)
 {
-	unsigned int host_clock = IMX6Q_HOST_CLOCK;   /* Hacking */
-
-/*	int ddr_pre_div = imx_data->is_ddr ? 2 : 1; */
-	int ddr_pre_div = 1;
+	struct pltfm_imx_data *imx_data = esdhc_priv(host);
+	struct esdhc_clk_div *d;
+	int ddr_pre_div = imx_data->is_ddr ? 2 : 1;
 	int pre_div = 1;
 	int div = 1;
-	u32 temp, val;
-
-	if (clock == 0) {
-		host->mmc->actual_clock = 0;
+	int i;
 
-		val = sdhci_readl(host, ESDHC_VENDOR_SPEC);
-		sdhci_writel(host, val & ~ESDHC_VENDOR_SPEC_FRC_SDCLK_ON,
-				ESDHC_VENDOR_SPEC);
-		return;
+	for (i = 0; i < ESDHC_CLK_CACHE_SIZE; i++) {
+		d = &imx_data->clk_div[i];
+		if (d->clock == clock && d->host_clock == host_clock &&
+		    d->ddr_pre_div == ddr_pre_div)
+			return d;
 	}
 
-	temp = sdhci_readl(host, ESDHC_SYSTEM_CONTROL);
-	temp &= ~(ESDHC_CLOCK_IPGEN | ESDHC_CLOCK_HCKEN | ESDHC_CLOCK_PEREN
-		| ESDHC_CLOCK_MASK);
-	sdhci_writel(host, temp, ESDHC_SYSTEM_CONTROL);
-
 	while (host_clock / (16 * pre_div * ddr_pre_div) > clock &&
 			pre_div < 256)
 		pre_div *= 2;
@@ -423,29 +1085,135 @@ static void imx6q_basicdrv_set_clock(
 	while (host_clock / (div * pre_div * ddr_pre_div) > clock && div < 16)
 		div++;
 
-	host->mmc->actual_clock = host_clock / (div * pre_div * ddr_pre_div);
-	dev_dbg(mmc_dev(host->mmc), "desired SD clock: %d, actual: %d\n",
-		clock, host->mmc->actual_clock);
-
-	pre_div >>= 1;
-	div--;
-
-	temp = sdhci_readl(host, ESDHC_SYSTEM_CONTROL);
-	temp |= (ESDHC_CLOCK_IPGEN | ESDHC_CLOCK_HCKEN | ESDHC_CLOCK_PEREN
-		| (div << ESDHC_DIVIDER_SHIFT)
-		| (pre_div << ESDHC_PREDIV_SHIFT));
-	sdhci_writel(host, temp, ESDHC_SYSTEM_CONTROL);
+	d = &imx_data->clk_div[imx_data->clk_div_next];
+	imx_data->clk_div_next =
+		(imx_data->clk_div_next + 1) % ESDHC_CLK_CACHE_SIZE;
 
-	val = sdhci_readl(host, ESDHC_VENDOR_SPEC);
-	sdhci_writel(host, val | ESDHC_VENDOR_SPEC_FRC_SDCLK_ON,
-		ESDHC_VENDOR_SPEC);
+	d->host_clock = host_clock;
+	d->clock = clock;
+	d->ddr_pre_div = ddr_pre_div;
+	d->actual = host_clock / (div * pre_div * ddr_pre_div);
+	d->pre_div = pre_div >> 1;
+	d->div = div - 1;
 
-	mdelay(1);
+	return d;
 }
 
-static unsigned int imx6q_basicdrv_get_ro(struct sdhci_host *host)
+static void imx6q_basicdrv_set_clock(
+	struct sdhci_host *host,
+	unsigned int clock)
 {
-	pr_debug("%s\n", mmc_hostname(host->mmc));
+	struct sdhci_pltfm_host *pltfm_host = sdhci_priv(host);
+	struct pltfm_imx_data *imx_data = esdhc_priv(host);
+	struct esdhc_clk_div *d;
+	int timeout = ESDHC_CLK_STABLE_TIMEOUT_US;
+	u32 temp, val;
+
+	if (clock == 0) {
+		host->mmc->actual_clock = 0;
+
+		val = imx_data->vendor_spec;
+		esdhc_write_vendor_spec(host,
+				val & ~ESDHC_VENDOR_SPEC_FRC_SDCLK_ON);
+		return;
+	}
+
+	d = imx6q_basicdrv_calc_clock(host, pltfm_host->clock, clock);
+
+	host->mmc->actual_clock = d->actual;
+	dev_dbg(mmc_dev(host->mmc), "desired SD clock: %d, actual: %d\n",
+		clock, host->mmc->actual_clock);
+
+	temp = ESDHC_CLOCK_EN_MASK
+		| (d->div << ESDHC_DIVIDER_SHIFT)
+		| (d->pre_div << ESDHC_PREDIV_SHIFT);
+
+	/*
+	 * Dividers already programmed (shadows are exact, see RESET_ALL).
+	 * On a timing change sdhci_set_ios() clears CARD_EN, which only
+	 * drops FRC_SDCLK_ON, and calls us again with the same rate: force
+	 * the clock back on, no need to rewrite SYSCTL or wait for SDSTB.
+	 */
+	if ((imx_data->sys_ctrl & (ESDHC_CLOCK_EN_MASK | ESDHC_CLOCK_MASK))
+			== temp) {
+		val = imx_data->vendor_spec;
+		if (!(val & ESDHC_VENDOR_SPEC_FRC_SDCLK_ON))
+			esdhc_write_vendor_spec(host,
+				val | ESDHC_VENDOR_SPEC_FRC_SDCLK_ON);
+		return;
+	}
+
+	esdhc_write_sys_ctrl(host, imx_data->sys_ctrl
+		& ~(ESDHC_CLOCK_EN_MASK | ESDHC_CLOCK_MASK));
+
+	esdhc_write_sys_ctrl(host, imx_data->sys_ctrl | temp);
+
+	val = imx_data->vendor_spec;
+	esdhc_write_vendor_spec(host, val | ESDHC_VENDOR_SPEC_FRC_SDCLK_ON);
+
+	/* wait for SDSTB instead of a fixed 1 ms */
+	while (!(esdhc_mmio_readl(host, ESDHC_PRSSTAT) & ESDHC_CLOCK_STABLE)) {
+		if (!timeout--) {
+			dev_warn(mmc_dev(host->mmc), "SD clock not stable\n");
+			return;
+		}
+		udelay(1);
+	}
+}
+
+/*
+ * PER clock rate change (DVFS): re-divide so the SD clock stays at or
+ * below what the core asked for. Going up, switch to the new dividers
+ * before the rate changes; going down, after it has changed.
+ */
+static void imx6q_basicdrv_update_host_clock(struct sdhci_host *host,
+	unsigned long rate)
+{
+	struct sdhci_pltfm_host *pltfm_host = sdhci_priv(host);
+	unsigned long flags;
+
+	spin_lock_irqsave(&host->lock, flags);
+	pltfm_host->clock = rate;
+	host->max_clk = rate;
+	if (host->clock)
+		imx6q_basicdrv_set_clock(host, host->clock);
+	spin_unlock_irqrestore(&host->lock, flags);
+}
+
+static int imx6q_basicdrv_clk_notifier(struct notifier_block *nb,
+	unsigned long event, void *data)
+{
+	struct pltfm_imx_data *imx_data =
+		container_of(nb, struct pltfm_imx_data, clk_nb);
+	struct clk_notifier_data *cnd = data;
+	struct sdhci_host *host = imx_data->host;
+
+	switch (event) {
+	case PRE_RATE_CHANGE:
+		if (cnd->new_rate > cnd->old_rate)
+			imx6q_basicdrv_update_host_clock(host, cnd->new_rate);
+		break;
+	case POST_RATE_CHANGE:
+		if (cnd->new_rate < cnd->old_rate)
+			imx6q_basicdrv_update_host_clock(host, cnd->new_rate);
+		break;
+	case ABORT_RATE_CHANGE:
+		if (cnd->new_rate > cnd->old_rate)
+			imx6q_basicdrv_update_host_clock(host, cnd->old_rate);
+		break;
+	default:
+		return NOTIFY_DONE;
+	}
+
+	dev_dbg(mmc_dev(host->mmc), "PER clock %lu -> %lu, SD clock %d\n",
+		cnd->old_rate, cnd->new_rate, host->mmc->actual_clock);
+
+	return NOTIFY_OK;
+}
+
+static unsigned int imx6q_basicdrv_get_ro(struct sdhci_host *host)
+{
+	pr_debug("%s\n", mmc_hostname(host->mmc));
 
 	return mmc_gpio_get_ro(host->mmc);
 }
@@ -475,60 +1243,194 @@ static void imx6q_basicdrv_reset_tuning(struct sdhci_host *host)
 	u32 ctrl;
 
 	/* Reset the tuning circuit */
-	ctrl = readl(host->ioaddr + ESDHC_MIX_CTRL);
+	ctrl = esdhc_priv(host)->mix_ctrl;
 	ctrl &= ~ESDHC_MIX_CTRL_SMPCLK_SEL;
 	ctrl &= ~ESDHC_MIX_CTRL_FBCLK_SEL;
-	writel(ctrl, host->ioaddr + ESDHC_MIX_CTRL);
-	writel(0, host->ioaddr + ESDHC_TUNE_CTRL_STATUS);
+	esdhc_write_mix_ctrl(host, ctrl);
+	esdhc_write_tune_ctrl(host, 0);
+}
+
+static void esdhc_set_strobe_dll(struct sdhci_host *host)
+{
+	u32 v;
+
+	if (host->mmc->actual_clock > ESDHC_STROBE_DLL_CLK_FREQ) {
+		/* disable clock before enabling strobe dll */
+		esdhc_write_vendor_spec(host, esdhc_priv(host)->vendor_spec
+				& ~ESDHC_VENDOR_SPEC_FRC_SDCLK_ON);
+
+		/* force a reset on strobe dll */
+		esdhc_mmio_writel(host, ESDHC_STROBE_DLL_CTRL_RESET,
+				ESDHC_STROBE_DLL_CTRL);
+		/*
+		 * enable strobe dll ctrl and adjust the delay target
+		 * for the uSDHC loopback read clock
+		 */
+		v = ESDHC_STROBE_DLL_CTRL_ENABLE |
+			(7 << ESDHC_STROBE_DLL_CTRL_SLV_DLY_TARGET_SHIFT);
+		esdhc_mmio_writel(host, v, ESDHC_STROBE_DLL_CTRL);
+		/* wait 1us to make sure strobe dll status register stable */
+		udelay(1);
+		v = esdhc_mmio_readl(host, ESDHC_STROBE_DLL_STATUS);
+		if (!(v & ESDHC_STROBE_DLL_STS_REF_LOCK))
+			dev_warn(mmc_dev(host->mmc),
+				"warning! HS400 strobe DLL status REF not lock!\n");
+		if (!(v & ESDHC_STROBE_DLL_STS_SLV_LOCK))
+			dev_warn(mmc_dev(host->mmc),
+				"warning! HS400 strobe DLL status SLV not lock!\n");
+	}
+}
+
+static int esdhc_change_pinstate(struct sdhci_host *host,
+	unsigned int uhs)
+{
+	struct pltfm_imx_data *imx_data = esdhc_priv(host);
+	struct pinctrl_state *pinctrl;
+
+	dev_dbg(mmc_dev(host->mmc), "change pinctrl state for uhs %d\n", uhs);
+
+	if (IS_ERR(imx_data->pinctrl) ||
+		IS_ERR(imx_data->pins_default) ||
+		IS_ERR(imx_data->pins_100mhz) ||
+		IS_ERR(imx_data->pins_200mhz))
+		return -EINVAL;
+
+	switch (uhs) {
+	case MMC_TIMING_UHS_SDR50:
+	case MMC_TIMING_UHS_DDR50:
+		pinctrl = imx_data->pins_100mhz;
+		break;
+	case MMC_TIMING_UHS_SDR104:
+	case MMC_TIMING_MMC_HS200:
+	case MMC_TIMING_MMC_HS400:
+		pinctrl = imx_data->pins_200mhz;
+		break;
+	default:
+		/* back to default state for other legacy timing */
+		pinctrl = imx_data->pins_default;
+	}
+
+	return pinctrl_select_state(imx_data->pinctrl, pinctrl);
 }
 
 static void imx6q_basicdrv_set_uhs_signaling(
 	struct sdhci_host *host,
 	unsigned timing)
 {
+	struct pltfm_imx_data *imx_data = esdhc_priv(host);
+	u32 m;
+
 	imx6q_basicdrv_reset_tuning(host);
 
-/*
+	/*
+	 * The core re-enables the SD clock (set_clock) right after this,
+	 * so is_ddr takes effect on the divider immediately.
+	 */
+	m = imx_data->mix_ctrl
+		& ~(ESDHC_MIX_CTRL_DDREN | ESDHC_MIX_CTRL_HS400_EN);
+	imx_data->is_ddr = false;
+
+	switch (timing) {
+	case MMC_TIMING_UHS_DDR50:
+	case MMC_TIMING_MMC_DDR52:
+		m |= ESDHC_MIX_CTRL_DDREN;
+		esdhc_write_mix_ctrl(host, m);
+		imx_data->is_ddr = true;
+		if (imx_data->delay_line)
+			esdhc_mmio_writel(host,
+				imx_data->delay_line << ESDHC_DLL_OVERRIDE_VAL_SHIFT
+				| (1 << ESDHC_DLL_OVERRIDE_EN_SHIFT),
+				ESDHC_DLL_CTRL);
+		break;
+	case MMC_TIMING_MMC_HS400:
+		m |= ESDHC_MIX_CTRL_DDREN | ESDHC_MIX_CTRL_HS400_EN;
+		esdhc_write_mix_ctrl(host, m);
+		imx_data->is_ddr = true;
+		/* update clock after enable DDR for strobe DLL lock */
+		imx6q_basicdrv_set_clock(host, host->clock);
+		esdhc_set_strobe_dll(host);
+		break;
+	default:
+		/* SDR modes incl. HS200, tuned by platform_execute_tuning */
+		esdhc_write_mix_ctrl(host, m);
+		break;
+	}
+
 	esdhc_change_pinstate(host, timing);
-*/
+}
+
+/*
+ * Wait for the card to go idle before the next tuning command. After a
+ * failed tuning block the core has already reset CMD/DAT on the host
+ * side, so the inhibit bits are clear; the card may still hold DAT0 low.
+ * Polling DAT0 replaces a blind mdelay(1) per tap.
+ */
+static void imx6q_basicdrv_wait_idle(struct sdhci_host *host)
+{
+	int timeout = ESDHC_TUNE_IDLE_TIMEOUT_US;
+	u32 prsstat;
+
+	for (;;) {
+		prsstat = esdhc_mmio_readl(host, ESDHC_PRSSTAT);
+		if ((prsstat & ESDHC_PRSSTAT_DAT0_LVL) &&
+		    !(prsstat & (SDHCI_CMD_INHIBIT | SDHCI_DATA_INHIBIT)))
+			return;
+		if (!timeout--) {
+			dev_dbg(mmc_dev(host->mmc),
+				"tuning: card still busy (DAT0 low)\n");
+			return;
+		}
+		udelay(1);
+	}
 }
 
 static void imx6q_basicdrv_prepare_tuning(struct sdhci_host *host, u32 val)
 {
 	u32 reg;
 
-	/* FIXME: delay a bit for card to be ready for next tuning due to errors */
-	mdelay(1);
+	/* card must be ready for next tuning due to errors */
+	imx6q_basicdrv_wait_idle(host);
 
-	reg = readl(host->ioaddr + ESDHC_MIX_CTRL);
+	reg = esdhc_priv(host)->mix_ctrl;
 	reg |= ESDHC_MIX_CTRL_EXE_TUNE | ESDHC_MIX_CTRL_SMPCLK_SEL |
 			ESDHC_MIX_CTRL_FBCLK_SEL;
-	writel(reg, host->ioaddr + ESDHC_MIX_CTRL);
-	writel(val << 8, host->ioaddr + ESDHC_TUNE_CTRL_STATUS);
+	esdhc_write_mix_ctrl(host, reg);
+	esdhc_write_tune_ctrl(host, val << 8);
 	dev_dbg(mmc_dev(host->mmc),
 		"tuning with delay 0x%x ESDHC_TUNE_CTRL_STATUS 0x%x\n",
-			val, readl(host->ioaddr + ESDHC_TUNE_CTRL_STATUS));
+			val, esdhc_priv(host)->tune_ctrl);
 }
 
 static void imx6q_basicdrv_post_tuning(struct sdhci_host *host)
 {
 	u32 reg;
 
-	reg = readl(host->ioaddr + ESDHC_MIX_CTRL);
+	reg = esdhc_priv(host)->mix_ctrl;
 	reg &= ~ESDHC_MIX_CTRL_EXE_TUNE;
 	reg |= ESDHC_MIX_CTRL_AUTO_TUNE_EN;
-	writel(reg, host->ioaddr + ESDHC_MIX_CTRL);
+	esdhc_write_mix_ctrl(host, reg);
 }
 
-static int imx6q_basicdrv_executing_tuning(struct sdhci_host *host, u32 opcode)
+/* Program one delay tap and send one tuning block, true if it passed */
+static bool imx6q_basicdrv_tune_tap(struct sdhci_host *host, u32 opcode,
+	int tap)
 {
-	int min, max, avg, ret;
+	imx6q_basicdrv_prepare_tuning(host, tap);
+	esdhc_priv(host)->tune_cmds++;
+
+	return !mmc_send_tuning(host->mmc, opcode, NULL);
+}
+
+/* Original linear scan, one tap at a time */
+static void imx6q_basicdrv_tune_linear(struct sdhci_host *host, u32 opcode,
+	int *min_tap, int *max_tap)
+{
+	int min, max;
 
 	/* find the mininum delay first which can pass tuning */
 	min = ESDHC_TUNE_CTRL_MIN;
 	while (min < ESDHC_TUNE_CTRL_MAX) {
-		imx6q_basicdrv_prepare_tuning(host, min);
-		if (!mmc_send_tuning(host->mmc, opcode, NULL))
+		if (imx6q_basicdrv_tune_tap(host, opcode, min))
 			break;
 		min += ESDHC_TUNE_CTRL_STEP;
 	}
@@ -536,26 +1438,531 @@ static int imx6q_basicdrv_executing_tuning(struct sdhci_host *host, u32 opcode)
 	/* find the maxinum delay which can not pass tuning */
 	max = min + ESDHC_TUNE_CTRL_STEP;
 	while (max < ESDHC_TUNE_CTRL_MAX) {
-		imx6q_basicdrv_prepare_tuning(host, max);
-		if (mmc_send_tuning(host->mmc, opcode, NULL)) {
+		if (!imx6q_basicdrv_tune_tap(host, opcode, max)) {
 			max -= ESDHC_TUNE_CTRL_STEP;
 			break;
 		}
 		max += ESDHC_TUNE_CTRL_STEP;
 	}
 
+	*min_tap = min;
+	*max_tap = max;
+}
+
+/* Bisect between a passing and a failing tap, return the last passing one */
+static int imx6q_basicdrv_tune_bisect(struct sdhci_host *host, u32 opcode,
+	int pass, int fail)
+{
+	int mid;
+
+	while (abs(pass - fail) > 1) {
+		mid = (pass + fail) / 2;
+		if (imx6q_basicdrv_tune_tap(host, opcode, mid))
+			pass = mid;
+		else
+			fail = mid;
+	}
+
+	return pass;
+}
+
+/*
+ * Coarse-to-fine scan: step ESDHC_TUNE_CTRL_COARSE_STEP taps until the
+ * first pass, then bisect inside the stride on each side to locate the
+ * window edges. About 16 + 2 * 3 commands instead of up to 128.
+ */
+static int imx6q_basicdrv_tune_coarse(struct sdhci_host *host, u32 opcode,
+	int *min_tap, int *max_tap)
+{
+	int pass, tap;
+
+	/* coarse: first passing tap */
+	for (tap = ESDHC_TUNE_CTRL_MIN; tap <= ESDHC_TUNE_CTRL_MAX;
+			tap += ESDHC_TUNE_CTRL_COARSE_STEP)
+		if (imx6q_basicdrv_tune_tap(host, opcode, tap))
+			break;
+	if (tap > ESDHC_TUNE_CTRL_MAX)
+		return -EIO;	/* window narrower than a stride */
+
+	/* fine: lower edge in (tap - stride, tap] */
+	*min_tap = imx6q_basicdrv_tune_bisect(host, opcode, tap,
+		max(tap - ESDHC_TUNE_CTRL_COARSE_STEP, ESDHC_TUNE_CTRL_MIN - 1));
+
+	/* coarse: first failing tap after the window */
+	pass = tap;
+	for (tap += ESDHC_TUNE_CTRL_COARSE_STEP; tap <= ESDHC_TUNE_CTRL_MAX;
+			tap += ESDHC_TUNE_CTRL_COARSE_STEP) {
+		if (!imx6q_basicdrv_tune_tap(host, opcode, tap))
+			break;
+		pass = tap;
+	}
+
+	/* fine: upper edge in [pass, fail) */
+	*max_tap = imx6q_basicdrv_tune_bisect(host, opcode, pass,
+		min(tap, ESDHC_TUNE_CTRL_MAX + 1));
+
+	return 0;
+}
+
+/*
+ * Re-tuning: the window only drifts a few taps (temperature), so look
+ * for its edges within ESDHC_TUNE_RETUNE_RANGE of the current tap.
+ * At most 1 + 2 * 4 commands instead of a scan from tap 0.
+ */
+static int imx6q_basicdrv_tune_local(struct sdhci_host *host, u32 opcode,
+	int center, int *min_tap, int *max_tap)
+{
+	int lo = max(center - ESDHC_TUNE_RETUNE_RANGE, ESDHC_TUNE_CTRL_MIN);
+	int hi = min(center + ESDHC_TUNE_RETUNE_RANGE, ESDHC_TUNE_CTRL_MAX);
+
+	if (!imx6q_basicdrv_tune_tap(host, opcode, center))
+		return -EIO;	/* drifted too far */
+
+	if (lo == center || imx6q_basicdrv_tune_tap(host, opcode, lo))
+		*min_tap = lo;
+	else
+		*min_tap = imx6q_basicdrv_tune_bisect(host, opcode, center, lo);
+
+	if (hi == center || imx6q_basicdrv_tune_tap(host, opcode, hi))
+		*max_tap = hi;
+	else
+		*max_tap = imx6q_basicdrv_tune_bisect(host, opcode, center, hi);
+
+	return 0;
+}
+
+/*
+ * Eye map: try every tap, keep the pass/fail map and pick the widest
+ * contiguous passing window. Slow (128 commands) but it does not land in
+ * a narrow window next to a glitchy single-tap pass.
+ */
+static int imx6q_basicdrv_tune_eye_map(struct sdhci_host *host, u32 opcode,
+	int *min_tap, int *max_tap)
+{
+	unsigned long *map = esdhc_priv(host)->tune_map;
+	unsigned long start, end;
+	int tap, best = -1, best_len = 0;
+
+	bitmap_zero(map, ESDHC_TUNE_CTRL_NUM);
+	for (tap = ESDHC_TUNE_CTRL_MIN; tap <= ESDHC_TUNE_CTRL_MAX; tap++)
+		if (imx6q_basicdrv_tune_tap(host, opcode, tap))
+			set_bit(tap, map);
+
+	for (start = find_first_bit(map, ESDHC_TUNE_CTRL_NUM);
+			start < ESDHC_TUNE_CTRL_NUM;
+			start = find_next_bit(map, ESDHC_TUNE_CTRL_NUM, end)) {
+		end = find_next_zero_bit(map, ESDHC_TUNE_CTRL_NUM, start);
+		if (end - start > best_len) {
+			best = start;
+			best_len = end - start;
+		}
+	}
+	if (best < 0)
+		return -EIO;
+
+	*min_tap = best;
+	*max_tap = best + best_len - 1;
+
+	return 0;
+}
+
+static bool imx6q_basicdrv_tune_cache_match(struct mmc_host *mmc,
+	struct esdhc_tune_cache *c)
+{
+	return c->clock && c->clock == mmc->ios.clock &&
+		c->timing == mmc->ios.timing;
+}
+
+static struct esdhc_tune_cache *imx6q_basicdrv_tune_cache_find(
+	struct sdhci_host *host)
+{
+	struct pltfm_imx_data *imx_data = esdhc_priv(host);
+	struct mmc_host *mmc = host->mmc;
+	struct esdhc_tune_cache *c;
+	int i;
+
+	if (!mmc->card)
+		return NULL;
+
+	for (i = 0; i < ESDHC_TUNE_CACHE_SIZE; i++) {
+		c = &imx_data->tune_cache[i];
+		if (!imx6q_basicdrv_tune_cache_match(mmc, c))
+			continue;
+		if (c->cid_pending) {
+			memcpy(c->cid, mmc->card->raw_cid, sizeof(c->cid));
+			c->cid_pending = false;
+		}
+		if (!memcmp(c->cid, mmc->card->raw_cid, sizeof(c->cid)))
+			return c;
+	}
+
+	return NULL;
+}
+
+static void imx6q_basicdrv_tune_cache_store(struct sdhci_host *host, int tap)
+{
+	struct pltfm_imx_data *imx_data = esdhc_priv(host);
+	struct mmc_host *mmc = host->mmc;
+	struct esdhc_tune_cache *c = NULL;
+	int i;
+
+	if (mmc->card) {
+		c = imx6q_basicdrv_tune_cache_find(host);
+	} else {
+		/* card init: reuse the not-yet-attached entry */
+		for (i = 0; i < ESDHC_TUNE_CACHE_SIZE; i++)
+			if (imx_data->tune_cache[i].cid_pending &&
+			    imx6q_basicdrv_tune_cache_match(mmc,
+					&imx_data->tune_cache[i]))
+				c = &imx_data->tune_cache[i];
+	}
+
+	if (!c) {
+		c = &imx_data->tune_cache[imx_data->tune_cache_next];
+		imx_data->tune_cache_next =
+			(imx_data->tune_cache_next + 1) % ESDHC_TUNE_CACHE_SIZE;
+	}
+
+	if (mmc->card)
+		memcpy(c->cid, mmc->card->raw_cid, sizeof(c->cid));
+	c->cid_pending = !mmc->card;
+	c->timing = mmc->ios.timing;
+	c->clock = mmc->ios.clock;
+	c->tap = tap;
+}
+
+static int imx6q_basicdrv_executing_tuning(struct sdhci_host *host, u32 opcode)
+{
+	struct pltfm_imx_data *imx_data = esdhc_priv(host);
+	struct esdhc_tune_cache *cache;
+	int min, max, avg, ret;
+	ktime_t start = ktime_get();
+
+	imx_data->tune_cmds = 0;
+	imx_data->tuning = true;
+
+	/*
+	 * Re-tuning requested by the core (SDHCI_TUNING_MODE_3, CRC errors):
+	 * timing and clock are unchanged, only search around the current tap.
+	 */
+	if (host->mmc->doing_retune && imx_data->tune_tap >= 0 &&
+	    !imx6q_basicdrv_tune_local(host, opcode, imx_data->tune_tap,
+			&min, &max)) {
+		avg = (min + max) / 2;
+		imx_data->retune_count++;
+		imx_data->retune_drift = avg - imx_data->tune_tap;
+		if (abs(imx_data->retune_drift) > imx_data->retune_drift_max)
+			imx_data->retune_drift_max = abs(imx_data->retune_drift);
+		goto check;
+	}
+
+	/*
+	 * Resume and card re-init end up here after set_uhs_signaling has
+	 * cleared the tuning circuit. If we know a good tap for this card
+	 * in this mode, one tuning command is enough to confirm it.
+	 */
+	cache = imx6q_basicdrv_tune_cache_find(host);
+	if (cache && imx6q_basicdrv_tune_tap(host, opcode, cache->tap)) {
+		avg = min = max = cache->tap;
+		ret = 0;
+		imx_data->tune_cache_hits++;
+		goto out;
+	}
+
+	switch (imx_data->tune_mode) {
+	case ESDHC_TUNE_ROBUST:
+		/* nothing passed, the final check below reports the error */
+		if (imx6q_basicdrv_tune_eye_map(host, opcode, &min, &max))
+			min = max = ESDHC_TUNE_CTRL_MIN;
+		break;
+	default:
+		if (imx6q_basicdrv_tune_coarse(host, opcode, &min, &max))
+			imx6q_basicdrv_tune_linear(host, opcode, &min, &max);
+		break;
+	}
+
 	/* use average delay to get the best timing */
 	avg = (min + max) / 2;
+check:
 	imx6q_basicdrv_prepare_tuning(host, avg);
 	ret = mmc_send_tuning(host->mmc, opcode, NULL);
+	imx_data->tune_cmds++;
+	if (!ret)
+		imx6q_basicdrv_tune_cache_store(host, avg);
+
+out:
 	imx6q_basicdrv_post_tuning(host);
 
-	dev_dbg(mmc_dev(host->mmc), "tuning %s at 0x%x ret %d\n",
-		ret ? "failed" : "passed", avg, ret);
+	imx_data->tune_time_us = ktime_us_delta(ktime_get(), start);
+	imx_data->tune_tap = avg;
+	imx_data->tune_count++;
+	imx_data->tuning = false;
+	if (!ret)
+		imx_data->err_streak = 0;
+
+	dev_dbg(mmc_dev(host->mmc),
+		"tuning %s at 0x%x [0x%x-0x%x] ret %d, CMD%d x %u, %u us\n",
+		ret ? "failed" : "passed", avg, min, max, ret,
+		opcode, imx_data->tune_cmds, imx_data->tune_time_us);
 
 	return ret;
 }
 
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(4, 20, 0)
+/*
+ * ADMA2 descriptor writer (sdhci_ops.adma_write_desc, since v4.20)
+ *
+ * Called by sdhci_adma_table_pre() for every scatterlist chunk. A chunk
+ * that starts where the previous data descriptor ends is folded into it
+ * (up to ESDHC_ADMA2_MAX_LEN): *desc is then not advanced. With
+ * SDHCI_QUIRK_NO_ENDATTR_IN_NOPDESC the core puts END on the last data
+ * descriptor, so a table never has NOP or zero-length entries.
+ */
+static void imx6q_basicdrv_adma_write_desc(struct sdhci_host *host,
+	void **desc, dma_addr_t addr, int len, unsigned int cmd)
+{
+	struct pltfm_imx_data *imx_data = esdhc_priv(host);
+	struct sdhci_adma2_32_desc *prev;
+	int prev_len;
+
+	if (*desc == host->adma_table)
+		imx_data->adma_tables++;
+	else if (cmd == ADMA2_TRAN_VALID && addr == imx_data->adma_next) {
+		/* cmd/len are at the same place in 32 and 64-bit descriptors */
+		prev = *desc - host->desc_sz;
+		prev_len = le16_to_cpu(prev->len);
+		if (le16_to_cpu(prev->cmd) == ADMA2_TRAN_VALID &&
+		    prev_len + len <= ESDHC_ADMA2_MAX_LEN) {
+			prev->len = cpu_to_le16(prev_len + len);
+			imx_data->adma_next += len;
+			imx_data->adma_merged++;
+			return;
+		}
+	}
+
+	if (!len && cmd == ADMA2_TRAN_VALID)
+		return;
+
+	sdhci_adma_write_desc(host, desc, addr, len, cmd);
+	imx_data->adma_next = addr + len;
+	imx_data->adma_descs++;
+}
+#endif
+
+/* Close the coalescing window: unmask the held interrupts again */
+static void imx6q_basicdrv_irq_release(struct sdhci_host *host)
+{
+	esdhc_priv(host)->irq_held = 0;
+	sdhci_writel(host, host->ier, SDHCI_SIGNAL_ENABLE);
+}
+
+static enum hrtimer_restart imx6q_basicdrv_irq_timer(struct hrtimer *t)
+{
+	struct pltfm_imx_data *imx_data =
+		container_of(t, struct pltfm_imx_data, irq_timer);
+	struct sdhci_host *host = imx_data->host;
+	unsigned long flags;
+
+	spin_lock_irqsave(&host->lock, flags);
+	if (imx_data->irq_held) {
+		imx6q_basicdrv_irq_release(host);
+		/* the interrupt this raises must not open a new window */
+		imx_data->irq_flush = true;
+	}
+	spin_unlock_irqrestore(&host->lock, flags);
+
+	return HRTIMER_NORESTART;
+}
+
+/*
+ * Interrupt coalescing (irq_coalesce_us != 0) holds back an interrupt
+ * that is known to be followed by another one shortly:
+ * - CQE: a task completion while more tasks are queued. Tasks that
+ *   complete in the window only set TCN bits, cqhci picks them all up
+ *   from one interrupt.
+ * - No CQE: the command response of a data command. Its transfer
+ *   complete follows once the data is moved, for short transfers
+ *   within a few us, so both are handled by one interrupt instead of
+ *   two.
+ * The held bit is masked in SIGNAL_ENABLE and hidden from INT_STATUS
+ * (accessors), so sdhci_irq() sees nothing left and returns. The next
+ * interrupt (transfer complete, error, card detect, ...) closes the
+ * window and takes the held bit along: it is still set in INT_STATUS
+ * and sdhci_irq() acks and handles it with the rest, the command
+ * before the data. When nothing comes within the budget the hrtimer
+ * unmasks it and it is handled by its own interrupt, late by at most
+ * the budget.
+ *
+ * With CQE, cqhci_irq() -> cqhci_finish_mrq() -> mmc_cqe_request_done()
+ * completes the tasks in hard IRQ context, so a window also batches
+ * that work. Without CQE sdhci completes the request from its finish
+ * tasklet either way; what is saved is the response interrupt.
+ */
+static u32 imx6q_basicdrv_irq_coalesce(struct sdhci_host *host, u32 intmask)
+{
+	struct pltfm_imx_data *imx_data = esdhc_priv(host);
+	u32 us = min(imx_data->irq_coalesce_us, (u32)ESDHC_IRQ_COALESCE_MAX_US);
+	u32 held = imx_data->irq_held;
+
+	if (held) {
+		hrtimer_try_to_cancel(&imx_data->irq_timer);
+		imx6q_basicdrv_irq_release(host);
+		return intmask | held;
+	}
+	if (imx_data->irq_flush) {
+		imx_data->irq_flush = false;
+		return intmask;
+	}
+
+	if (!us || imx_data->tuning)
+		return intmask;
+
+	if (host->cqe_on) {
+		if (intmask != SDHCI_INT_CQE || host->mmc->cqe_qcnt < 2)
+			return intmask;
+	} else if (intmask != SDHCI_INT_RESPONSE || !host->data ||
+		   host->cmd != host->data_cmd) {
+		return intmask;
+	}
+
+	imx_data->irq_held = intmask;
+	imx_data->irq_windows++;
+	sdhci_writel(host, host->ier, SDHCI_SIGNAL_ENABLE);
+	hrtimer_start(&imx_data->irq_timer, us_to_ktime(us), HRTIMER_MODE_REL);
+
+	return 0;
+}
+
+/*
+ * Command Queue Engine
+ * With CQE on, SDHC interrupts are routed to CQHCI (see CQE/README.md)
+ */
+/*
+ * sdhci_ops.irq, runs before the core looks at the interrupt status:
+ * hand CQE interrupts to cqhci, keep track of errors for
+ * imx6q_basicdrv_reset().
+ */
+static u32 imx6q_basicdrv_irq(struct sdhci_host *host, u32 intmask)
+{
+	struct pltfm_imx_data *imx_data = esdhc_priv(host);
+	int cmd_error = 0;
+	int data_error = 0;
+
+	this_cpu_inc(imx_data->stats->irqs);
+	trace_basicdrv_irq(host, intmask);
+
+	intmask = imx6q_basicdrv_irq_coalesce(host, intmask);
+	if (!intmask)
+		return 0;
+
+	if (sdhci_cqe_irq(host, intmask, &cmd_error, &data_error)) {
+		cqhci_irq(host->mmc, intmask, cmd_error, data_error);
+		return 0;
+	}
+
+	if (imx_data->tuning)
+		return intmask;
+
+	/* debugfs error injection: report a good transfer as a data CRC error */
+	if (unlikely(imx_data->inject_crc) && (intmask & SDHCI_INT_DATA_END)) {
+		imx_data->inject_crc--;
+		intmask |= SDHCI_INT_DATA_CRC;
+	}
+
+	if (unlikely(intmask & ESDHC_INT_RECOVER_MASK)) {
+		imx_data->errors++;
+		imx_data->err_streak++;
+		imx_data->err_time = ktime_get();
+		if (intmask & (SDHCI_INT_TIMEOUT | SDHCI_INT_DATA_TIMEOUT))
+			imx_data->timeouts++;
+		imx_data->req_bytes = 0;
+		imx_data->req_seq++;
+	} else if (intmask & SDHCI_INT_DATA_END) {
+		imx_data->err_streak = 0;
+		imx_data->req_seq++;
+		esdhc_stats_done(host);
+	}
+
+	return intmask;
+}
+
+/*
+ * Polled completion (poll_max_bytes != 0): after issuing a read of at
+ * most poll_max_bytes, spin on INT_STATUS for up to poll_us instead of
+ * going idle until the interrupt. The completion is still handled by
+ * sdhci_irq() (it is not exported), the spin keeps this CPU out of
+ * cpuidle and the issuing context running, so the wakeup latency is
+ * not added to short card accesses. When the budget runs out the
+ * request simply completes by interrupt.
+ *
+ * The loop reads the register directly, without host->lock: the
+ * counting accessors would race with the IRQ handler on the per-host
+ * MMIO counters. Completion and error bits need no translation (the
+ * uSDHC DMA error bit 28 is in SDHCI_INT_ERROR_MASK too).
+ *
+ * Never used for CQE requests (cqhci_request does not come through here).
+ */
+static void imx6q_basicdrv_request(struct mmc_host *mmc,
+	struct mmc_request *mrq)
+{
+	struct sdhci_host *host = mmc_priv(mmc);
+	struct pltfm_imx_data *imx_data = esdhc_priv(host);
+	struct mmc_data *data = mrq->data;
+	u32 us = min(imx_data->poll_us, (u32)ESDHC_POLL_MAX_US);
+	u32 seq = READ_ONCE(imx_data->req_seq);
+	bool poll;
+	ktime_t timeout;
+
+	/* mrq may be gone once the request is issued */
+	poll = imx_data->poll_max_bytes && us &&
+		data && (data->flags & MMC_DATA_READ) &&
+		data->blksz * data->blocks <= imx_data->poll_max_bytes;
+
+	imx_data->sdhci_request(mmc, mrq);
+
+	if (!poll)
+		return;
+
+	timeout = ktime_add_us(ktime_get(), us);
+	do {
+		if (READ_ONCE(imx_data->req_seq) != seq ||
+		    (readl(host->ioaddr + SDHCI_INT_STATUS) &
+		     (SDHCI_INT_DATA_END | SDHCI_INT_ERROR_MASK))) {
+			imx_data->poll_hits++;
+			return;
+		}
+		cpu_relax();
+	} while (ktime_before(ktime_get(), timeout));
+
+	imx_data->poll_misses++;
+}
+
+static void imx6q_basicdrv_cqe_enable(struct mmc_host *mmc)
+{
+	struct sdhci_host *host = mmc_priv(mmc);
+	u32 reg;
+
+	/* CQE must not start with data left in the buffer */
+	reg = sdhci_readl(host, SDHCI_PRESENT_STATE);
+	while (reg & SDHCI_DATA_AVAILABLE) {
+		sdhci_readl(host, SDHCI_BUFFER);
+		reg = sdhci_readl(host, SDHCI_PRESENT_STATE);
+	}
+
+	sdhci_cqe_enable(mmc);
+}
+
+static void imx6q_basicdrv_cqe_dumpregs(struct mmc_host *mmc)
+{
+	sdhci_dumpregs(mmc_priv(mmc));
+}
+
+static const struct cqhci_host_ops imx6q_basicdrv_cqhci_ops = {
+	.enable = imx6q_basicdrv_cqe_enable,
+	.disable = sdhci_cqe_disable,
+	.dumpregs = imx6q_basicdrv_cqe_dumpregs,
+};
+
 
 static const struct sdhci_ops sdhci_basicdrv_ops = {
 #ifdef CONFIG_MMC_SDHCI_IO_ACCESSORS
@@ -577,6 +1984,10 @@ static const struct sdhci_ops sdhci_basicdrv_ops = {
 	.set_bus_width = imx6q_basicdrv_set_bus_width,
 	.set_uhs_signaling = imx6q_basicdrv_set_uhs_signaling,
 	.platform_execute_tuning = imx6q_basicdrv_executing_tuning,
+	.irq = imx6q_basicdrv_irq,
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(4, 20, 0)
+	.adma_write_desc = imx6q_basicdrv_adma_write_desc,
+#endif
 
 /*  ***WARNING: TBD (sdhci-pci-core.c)
 	.enable_dma	= sdhci_pci_enable_dma, (synopsys)
@@ -597,13 +2008,68 @@ static const struct sdhci_pltfm_data sdhci_basicdrv_pdata = {
 	.ops = &sdhci_basicdrv_ops,
 };
 
+/* Count what each transfer engine costs in interrupts */
+static u32 sdhci_basicdrv_std_irq(struct sdhci_host *host, u32 intmask)
+{
+	struct pltfm_imx_data *imx_data = esdhc_priv(host);
+
+	if (intmask & SDHCI_INT_DMA_END)
+		imx_data->dma_irqs++;
+	if (intmask & SDHCI_INT_DATA_END)
+		imx_data->data_irqs++;
+
+	return intmask;
+}
+
+/*
+ * Spec compliant controllers (e.g. Arasan on Zynq, see microzed/):
+ * no read_l/write_l..., sdhci_readl() is a plain readl() after one NULL
+ * check. Base/timeout clock come from "clk_xin".
+ */
+static const struct sdhci_ops sdhci_basicdrv_std_ops = {
+	.set_clock = sdhci_set_clock,
+	.set_bus_width = sdhci_set_bus_width,
+	.reset = sdhci_reset,
+	.set_uhs_signaling = sdhci_set_uhs_signaling,
+	.set_power = sdhci_set_power,
+	.get_max_clock = sdhci_pltfm_clk_get_max_clock,
+	.get_timeout_clock = sdhci_pltfm_clk_get_max_clock,
+	.irq = sdhci_basicdrv_std_irq,
+};
+
+static const struct sdhci_pltfm_data sdhci_basicdrv_std_pdata = {
+	.quirks = SDHCI_QUIRK_CAP_CLOCK_BASE_BROKEN,
+	.ops = &sdhci_basicdrv_std_ops,
+};
+
+static const struct esdhc_soc_data usdhc_imx6q_data = {
+	.flags = ESDHC_FLAG_USDHC | ESDHC_FLAG_MAN_TUNING,
+	.pdata = &sdhci_basicdrv_pdata,
+};
+
+static const struct esdhc_soc_data usdhc_hs400_data = {
+	.flags = ESDHC_FLAG_USDHC | ESDHC_FLAG_MAN_TUNING
+			| ESDHC_FLAG_HS200 | ESDHC_FLAG_HS400,
+	.pdata = &sdhci_basicdrv_pdata,
+};
+
+static const struct esdhc_soc_data sdhci_std_data = {
+	.pdata = &sdhci_basicdrv_std_pdata,
+};
+
+static inline bool esdhc_is_usdhc(struct pltfm_imx_data *data)
+{
+	return !!(data->socdata->flags & ESDHC_FLAG_USDHC);
+}
+
 static void imx6q_basicdrv_hwinit(struct sdhci_host *host)
 {
 	/*
 	 * The imx6q ROM code will change the default watermark
 	 * level setting to something insane.  Change it back here.
+	 * (ESDHC_WTMK_DEFAULT_VAL unless the DT says otherwise)
 	 */
-	writel(ESDHC_WTMK_DEFAULT_VAL, host->ioaddr + ESDHC_WTMK_LVL);
+	writel(esdhc_priv(host)->wtmk_lvl, host->ioaddr + ESDHC_WTMK_LVL);
 
 	/*
 	 * ROM code will change the bit burst_length_enable setting
@@ -630,42 +2096,676 @@ static void imx6q_basicdrv_hwinit(struct sdhci_host *host)
 	writel(0x0, host->ioaddr + ESDHC_DLL_CTRL);
 }
 
+/* Replace one WTMK_LVL field when the DT property exists */
+static void esdhc_of_wtmk_field(struct device_node *np, const char *name,
+	u32 *wtmk, int shift, u32 mask)
+{
+	u32 val;
+
+	if (of_property_read_u32(np, name, &val))
+		return;
+
+	*wtmk = (*wtmk & ~(mask << shift)) | ((val & mask) << shift);
+}
+
+static void imx6q_basicdrv_parse_dt(struct platform_device *pdev,
+	struct sdhci_host *host)
+{
+	struct device_node *np = pdev->dev.of_node;
+	struct pltfm_imx_data *imx_data = esdhc_priv(host);
+
+	/*
+	 * DMA watermark / burst length. The AXI bus may be shared with
+	 * other masters (display), so the best values are board specific.
+	 */
+	imx_data->wtmk_lvl = ESDHC_WTMK_DEFAULT_VAL;
+	esdhc_of_wtmk_field(np, "virtualcom,rd-wml", &imx_data->wtmk_lvl,
+		ESDHC_WTMK_LVL_RD_WML_SHIFT, ESDHC_WTMK_LVL_WML_MASK);
+	esdhc_of_wtmk_field(np, "virtualcom,rd-burst-len", &imx_data->wtmk_lvl,
+		ESDHC_WTMK_LVL_RD_BRST_SHIFT, ESDHC_WTMK_LVL_BRST_MASK);
+	esdhc_of_wtmk_field(np, "virtualcom,wr-wml", &imx_data->wtmk_lvl,
+		ESDHC_WTMK_LVL_WR_WML_SHIFT, ESDHC_WTMK_LVL_WML_MASK);
+	esdhc_of_wtmk_field(np, "virtualcom,wr-burst-len", &imx_data->wtmk_lvl,
+		ESDHC_WTMK_LVL_WR_BRST_SHIFT, ESDHC_WTMK_LVL_BRST_MASK);
+
+	imx_data->has_cqe = of_property_read_bool(np, "supports-cqe");
+
+	of_property_read_u32(np, "virtualcom,irq-coalesce-us",
+			&imx_data->irq_coalesce_us);
+	of_property_read_u32(np, "virtualcom,poll-max-bytes",
+			&imx_data->poll_max_bytes);
+	if (of_property_read_u32(np, "virtualcom,poll-us",
+			&imx_data->poll_us))
+		imx_data->poll_us = ESDHC_POLL_US_DEFAULT;
+
+	if (of_property_read_u32(np, "virtualcom,data-timeout-ms",
+			&imx_data->data_timeout_ms))
+		imx_data->data_timeout_ms = 0;
+	if (of_property_read_u32(np, "virtualcom,data-timeout-margin",
+			&imx_data->data_timeout_margin))
+		imx_data->data_timeout_margin = ESDHC_DATA_TIMEOUT_MARGIN;
+
+	if (of_property_read_u32(np, "virtualcom,delay-line",
+			&imx_data->delay_line))
+		imx_data->delay_line = 0;
+
+	if (of_property_match_string(np, "virtualcom,tuning-mode", "robust") >= 0)
+		imx_data->tune_mode = ESDHC_TUNE_ROBUST;
+	else
+		imx_data->tune_mode = ESDHC_TUNE_FAST;
+}
+
+/* Spec compliant hosts: turn the requested engine into quirks */
+static void sdhci_basicdrv_std_parse_dma(struct platform_device *pdev,
+	struct sdhci_host *host)
+{
+	struct pltfm_imx_data *imx_data = esdhc_priv(host);
+	const char *mode = dma_mode;
+	int ret;
+
+	if (!mode &&
+	    of_property_read_string(pdev->dev.of_node, "virtualcom,dma-mode",
+			&mode))
+		return;
+
+	ret = match_string(basicdrv_dma_names, ARRAY_SIZE(basicdrv_dma_names),
+			mode);
+	if (ret < 0) {
+		dev_warn(&pdev->dev, "unknown dma-mode \"%s\"\n", mode);
+		return;
+	}
+	imx_data->dma = ret;
+
+	switch (imx_data->dma) {
+	case BASICDRV_DMA_PIO:
+		host->quirks |= SDHCI_QUIRK_BROKEN_DMA | SDHCI_QUIRK_BROKEN_ADMA;
+		break;
+	case BASICDRV_DMA_SDMA:
+		host->quirks |= SDHCI_QUIRK_BROKEN_ADMA;
+		/* SDMA is 32-bit only, sdhci drops it on 64-bit capable hosts */
+		host->quirks2 |= SDHCI_QUIRK2_BROKEN_64_BIT_DMA;
+		break;
+	case BASICDRV_DMA_ADMA32:
+		host->quirks2 |= SDHCI_QUIRK2_BROKEN_64_BIT_DMA;
+		break;
+	default:
+		break;
+	}
+}
+
+/* What sdhci_setup_host() ended up with (it may fall back to PIO) */
+static const char *sdhci_basicdrv_dma_engine(struct sdhci_host *host)
+{
+	if (host->flags & SDHCI_USE_ADMA)
+		return host->flags & SDHCI_USE_64_BIT_DMA ? "adma64" : "adma32";
+	if (host->flags & SDHCI_USE_SDMA)
+		return "sdma";
+	return "pio";
+}
+
+#ifdef CONFIG_DEBUG_FS
+static int imx6q_basicdrv_mmio_show(struct seq_file *s, void *data)
+{
+	struct sdhci_host *host = s->private;
+	struct pltfm_imx_data *imx_data = esdhc_priv(host);
+	u64 cmds = imx_data->cmd_count;
+
+	seq_printf(s, "reads:    %llu\n", imx_data->mmio_reads);
+	seq_printf(s, "writes:   %llu\n", imx_data->mmio_writes);
+	seq_printf(s, "commands: %llu\n", cmds);
+	if (cmds) {
+		seq_printf(s, "reads/cmd:  %llu\n",
+			div64_u64(imx_data->mmio_reads, cmds));
+		seq_printf(s, "writes/cmd: %llu\n",
+			div64_u64(imx_data->mmio_writes, cmds));
+	}
+
+	return 0;
+}
+DEFINE_SHOW_ATTRIBUTE(imx6q_basicdrv_mmio);
+
+/* reg, read/write, calls, uSDHC reads and writes per call (x.yy) */
+static int imx6q_basicdrv_mmio_ops_show(struct seq_file *s, void *data)
+{
+	struct sdhci_host *host = s->private;
+	struct pltfm_imx_data *imx_data = esdhc_priv(host);
+	struct esdhc_op_cost *c;
+	u32 r, w;
+	int write, reg;
+
+	seq_puts(s, "reg  op calls      reads/call writes/call\n");
+	for (reg = 0; reg < ESDHC_SDHCI_REG_NUM; reg++)
+		for (write = 0; write < 2; write++) {
+			c = &imx_data->op_cost[write][reg];
+			if (!c->calls)
+				continue;
+			r = div_u64(c->reads * 100ULL, c->calls);
+			w = div_u64(c->writes * 100ULL, c->calls);
+			seq_printf(s, "0x%02x %s  %-10u %u.%02u       %u.%02u\n",
+				reg, write ? "w" : "r", c->calls,
+				r / 100, r % 100, w / 100, w % 100);
+		}
+
+	return 0;
+}
+DEFINE_SHOW_ATTRIBUTE(imx6q_basicdrv_mmio_ops);
+
+static int imx6q_basicdrv_op_cost_get(void *data, u64 *val)
+{
+	*val = esdhc_priv(data)->op_cost_on;
+
+	return 0;
+}
+
+/* Serializes op_cost_on flips against the static key count */
+static DEFINE_MUTEX(esdhc_op_cost_lock);
+
+/* Per host switch, the static key counts the hosts that have it on */
+static void imx6q_basicdrv_op_cost_enable(struct sdhci_host *host, bool on)
+{
+	struct pltfm_imx_data *imx_data = esdhc_priv(host);
+
+	mutex_lock(&esdhc_op_cost_lock);
+	if (imx_data->op_cost_on != on) {
+		imx_data->op_cost_on = on;
+		if (on)
+			static_branch_inc(&esdhc_op_cost_key);
+		else
+			static_branch_dec(&esdhc_op_cost_key);
+	}
+	mutex_unlock(&esdhc_op_cost_lock);
+}
+
+static int imx6q_basicdrv_op_cost_set(void *data, u64 val)
+{
+	imx6q_basicdrv_op_cost_enable(data, !!val);
+
+	return 0;
+}
+DEFINE_DEBUGFS_ATTRIBUTE(imx6q_basicdrv_op_cost_fops, imx6q_basicdrv_op_cost_get,
+	imx6q_basicdrv_op_cost_set, "%llu\n");
+
+static int imx6q_basicdrv_tuning_show(struct seq_file *s, void *data)
+{
+	struct sdhci_host *host = s->private;
+	struct pltfm_imx_data *imx_data = esdhc_priv(host);
+
+	seq_printf(s, "count:   %llu\n", imx_data->tune_count);
+	seq_printf(s, "tap:     %d\n", imx_data->tune_tap);
+	seq_printf(s, "cmds:    %u\n", imx_data->tune_cmds);
+	seq_printf(s, "time_us: %u\n", imx_data->tune_time_us);
+	seq_printf(s, "cache_hits: %llu\n", imx_data->tune_cache_hits);
+	seq_printf(s, "retunes: %llu\n", imx_data->retune_count);
+	seq_printf(s, "drift:   %d (max %d)\n", imx_data->retune_drift,
+		imx_data->retune_drift_max);
+	seq_printf(s, "mode:    %s\n",
+		imx_data->tune_mode == ESDHC_TUNE_ROBUST ? "robust" : "fast");
+
+	return 0;
+}
+DEFINE_SHOW_ATTRIBUTE(imx6q_basicdrv_tuning);
+
+static int imx6q_basicdrv_adma_show(struct seq_file *s, void *data)
+{
+	struct sdhci_host *host = s->private;
+	struct pltfm_imx_data *imx_data = esdhc_priv(host);
+	u64 tables = imx_data->adma_tables;
+
+	seq_printf(s, "tables:      %llu\n", tables);
+	seq_printf(s, "descriptors: %llu\n", imx_data->adma_descs);
+	seq_printf(s, "merged:      %llu\n", imx_data->adma_merged);
+	if (tables)
+		seq_printf(s, "descs/table: %llu\n",
+			div64_u64(imx_data->adma_descs, tables));
+
+	return 0;
+}
+DEFINE_SHOW_ATTRIBUTE(imx6q_basicdrv_adma);
+
+/* One character per tap ('+' pass, '-' fail, '*' chosen), 32 per line */
+static int imx6q_basicdrv_eye_map_show(struct seq_file *s, void *data)
+{
+	struct sdhci_host *host = s->private;
+	struct pltfm_imx_data *imx_data = esdhc_priv(host);
+	int tap;
+
+	for (tap = ESDHC_TUNE_CTRL_MIN; tap <= ESDHC_TUNE_CTRL_MAX; tap++) {
+		if (tap % 32 == 0)
+			seq_printf(s, "%3d: ", tap);
+		if (tap == imx_data->tune_tap)
+			seq_putc(s, '*');
+		else
+			seq_putc(s, test_bit(tap, imx_data->tune_map) ? '+' : '-');
+		if (tap % 32 == 31)
+			seq_putc(s, '\n');
+	}
+
+	return 0;
+}
+DEFINE_SHOW_ATTRIBUTE(imx6q_basicdrv_eye_map);
+
+static int imx6q_basicdrv_recovery_show(struct seq_file *s, void *data)
+{
+	struct sdhci_host *host = s->private;
+	struct pltfm_imx_data *imx_data = esdhc_priv(host);
+
+	seq_printf(s, "errors:      %llu\n", imx_data->errors);
+	seq_printf(s, "streak:      %u\n", imx_data->err_streak);
+	seq_printf(s, "line_resets: %llu\n", imx_data->line_resets);
+	seq_printf(s, "retunes:     %llu\n", imx_data->err_retunes);
+	seq_printf(s, "full_resets: %llu\n", imx_data->full_resets);
+	seq_printf(s, "recovery_ns: %llu (max %llu)\n", imx_data->recovery_ns,
+		imx_data->recovery_ns_max);
+
+	return 0;
+}
+DEFINE_SHOW_ATTRIBUTE(imx6q_basicdrv_recovery);
+
+static void esdhc_stats_sum(struct pltfm_imx_data *imx_data,
+	struct esdhc_stats *sum)
+{
+	struct esdhc_stats *st;
+	int cpu, dir, cls, b;
+
+	memset(sum, 0, sizeof(*sum));
+	for_each_possible_cpu(cpu) {
+		st = per_cpu_ptr(imx_data->stats, cpu);
+		sum->requests += st->requests;
+		sum->irqs += st->irqs;
+		for (dir = 0; dir < 2; dir++) {
+			sum->bytes[dir] += st->bytes[dir];
+			for (cls = 0; cls < ESDHC_SIZE_CLASSES; cls++)
+				for (b = 0; b < ESDHC_HIST_BUCKETS; b++)
+					sum->hist[dir][cls][b] +=
+						st->hist[dir][cls][b];
+		}
+	}
+}
+
+static const char * const esdhc_size_class_name[] = {
+	[ESDHC_SIZE_512] = "<=512",
+	[ESDHC_SIZE_4K] = "<=4K",
+	[ESDHC_SIZE_64K] = "<=64K",
+	[ESDHC_SIZE_BIG] = ">64K",
+};
+
+static int imx6q_basicdrv_stats_show(struct seq_file *s, void *data)
+{
+	struct sdhci_host *host = s->private;
+	struct pltfm_imx_data *imx_data = esdhc_priv(host);
+	struct mmc_ios *ios = &host->mmc->ios;
+	struct esdhc_stats *sum;
+
+	sum = kmalloc(sizeof(*sum), GFP_KERNEL);
+	if (!sum)
+		return -ENOMEM;
+	esdhc_stats_sum(imx_data, sum);
+
+	seq_printf(s, "requests:    %llu\n", sum->requests);
+	seq_printf(s, "read_bytes:  %llu\n", sum->bytes[1]);
+	seq_printf(s, "write_bytes: %llu\n", sum->bytes[0]);
+	seq_printf(s, "commands:    %llu\n", imx_data->cmd_count);
+	seq_printf(s, "irqs:        %llu\n", sum->irqs);
+	seq_printf(s, "timeouts:    %llu\n", imx_data->timeouts);
+	seq_printf(s, "irq_windows: %llu (%u us)\n", imx_data->irq_windows,
+		imx_data->irq_coalesce_us);
+	seq_printf(s, "polled:      %llu hit, %llu miss (<= %u bytes, %u us)\n",
+		imx_data->poll_hits, imx_data->poll_misses,
+		imx_data->poll_max_bytes, imx_data->poll_us);
+	seq_printf(s, "resets:      %llu line, %llu full\n",
+		imx_data->line_resets, imx_data->full_resets);
+	seq_printf(s, "tunings:     %llu (%llu re-tunes)\n",
+		imx_data->tune_count, imx_data->retune_count);
+	seq_printf(s, "clock:       %u Hz\n", host->mmc->actual_clock);
+	seq_printf(s, "timing:      %u\n", ios->timing);
+	seq_printf(s, "bus_width:   %u\n", 1 << ios->bus_width);
+
+	kfree(sum);
+
+	return 0;
+}
+DEFINE_SHOW_ATTRIBUTE(imx6q_basicdrv_stats);
+
+/* One line per non-empty bucket: dir size-class bucket-limit count */
+static int imx6q_basicdrv_latency_show(struct seq_file *s, void *data)
+{
+	struct sdhci_host *host = s->private;
+	struct esdhc_stats *sum;
+	int dir, cls, b;
+
+	sum = kmalloc(sizeof(*sum), GFP_KERNEL);
+	if (!sum)
+		return -ENOMEM;
+	esdhc_stats_sum(esdhc_priv(host), sum);
+
+	for (dir = 1; dir >= 0; dir--)
+		for (cls = 0; cls < ESDHC_SIZE_CLASSES; cls++)
+			for (b = 0; b < ESDHC_HIST_BUCKETS; b++) {
+				if (!sum->hist[dir][cls][b])
+					continue;
+				seq_printf(s, "%s %-5s <%8lluus %llu\n",
+					dir ? "read " : "write",
+					esdhc_size_class_name[cls], 1ULL << b,
+					sum->hist[dir][cls][b]);
+			}
+
+	kfree(sum);
+
+	return 0;
+}
+DEFINE_SHOW_ATTRIBUTE(imx6q_basicdrv_latency);
+
+static int imx6q_basicdrv_wtmk_get(void *data, u64 *val)
+{
+	struct sdhci_host *host = data;
+
+	*val = esdhc_priv(host)->wtmk_lvl;
+
+	return 0;
+}
+
+/* Takes effect immediately, for sweeping values under a real workload */
+static int imx6q_basicdrv_wtmk_set(void *data, u64 val)
+{
+	struct sdhci_host *host = data;
+	unsigned long flags;
+
+	spin_lock_irqsave(&host->lock, flags);
+	esdhc_priv(host)->wtmk_lvl = val;
+	esdhc_mmio_writel(host, val, ESDHC_WTMK_LVL);
+	spin_unlock_irqrestore(&host->lock, flags);
+
+	return 0;
+}
+DEFINE_DEBUGFS_ATTRIBUTE(imx6q_basicdrv_wtmk_fops, imx6q_basicdrv_wtmk_get,
+	imx6q_basicdrv_wtmk_set, "0x%08llx\n");
+
+/* Files live in the mmc core's per-host directory (/sys/kernel/debug/mmcX) */
+static void imx6q_basicdrv_debugfs_init(struct sdhci_host *host)
+{
+	struct pltfm_imx_data *imx_data = esdhc_priv(host);
+	struct dentry *root = host->mmc->debugfs_root;
+
+	if (!root)
+		return;
+
+	debugfs_create_file("basicdrv_mmio", 0444, root, host,
+			&imx6q_basicdrv_mmio_fops);
+	debugfs_create_file_unsafe("basicdrv_mmio_ops_enable", 0644, root,
+			host, &imx6q_basicdrv_op_cost_fops);
+	debugfs_create_file("basicdrv_mmio_ops", 0444, root, host,
+			&imx6q_basicdrv_mmio_ops_fops);
+	debugfs_create_file("basicdrv_tuning", 0444, root, host,
+			&imx6q_basicdrv_tuning_fops);
+	debugfs_create_file("basicdrv_eye_map", 0444, root, host,
+			&imx6q_basicdrv_eye_map_fops);
+	debugfs_create_file("basicdrv_adma", 0444, root, host,
+			&imx6q_basicdrv_adma_fops);
+	debugfs_create_file_unsafe("basicdrv_wtmk_lvl", 0644, root, host,
+			&imx6q_basicdrv_wtmk_fops);
+	/* Read on every command, a write applies to the next one */
+	debugfs_create_u32("basicdrv_data_timeout_ms", 0644, root,
+			&imx_data->data_timeout_ms);
+	debugfs_create_u32("basicdrv_data_timeout_margin", 0644, root,
+			&imx_data->data_timeout_margin);
+	debugfs_create_u8("basicdrv_dtocv", 0444, root, &imx_data->dtocv);
+	debugfs_create_file("basicdrv_recovery", 0444, root, host,
+			&imx6q_basicdrv_recovery_fops);
+	debugfs_create_file("basicdrv_stats", 0444, root, host,
+			&imx6q_basicdrv_stats_fops);
+	debugfs_create_file("basicdrv_latency", 0444, root, host,
+			&imx6q_basicdrv_latency_fops);
+	debugfs_create_u32("basicdrv_inject_crc", 0644, root,
+			&imx_data->inject_crc);
+	/* Applies from the next window on */
+	debugfs_create_u32("basicdrv_irq_coalesce_us", 0644, root,
+			&imx_data->irq_coalesce_us);
+	debugfs_create_u32("basicdrv_poll_max_bytes", 0644, root,
+			&imx_data->poll_max_bytes);
+	debugfs_create_u32("basicdrv_poll_us", 0644, root,
+			&imx_data->poll_us);
+}
+
+static int sdhci_basicdrv_dma_show(struct seq_file *s, void *data)
+{
+	struct sdhci_host *host = s->private;
+	struct pltfm_imx_data *imx_data = esdhc_priv(host);
+
+	seq_printf(s, "engine:    %s\n", sdhci_basicdrv_dma_engine(host));
+	seq_printf(s, "requested: %s\n", basicdrv_dma_names[imx_data->dma]);
+	seq_printf(s, "dma_irqs:  %llu\n", imx_data->dma_irqs);
+	seq_printf(s, "data_irqs: %llu\n", imx_data->data_irqs);
+
+	return 0;
+}
+DEFINE_SHOW_ATTRIBUTE(sdhci_basicdrv_dma);
+
+/* Spec compliant hosts: none of the uSDHC files apply */
+static void sdhci_basicdrv_std_debugfs_init(struct sdhci_host *host)
+{
+	struct dentry *root = host->mmc->debugfs_root;
+
+	if (!root)
+		return;
+
+	debugfs_create_file("basicdrv_dma", 0444, root, host,
+			&sdhci_basicdrv_dma_fops);
+}
+#else
+static inline void imx6q_basicdrv_debugfs_init(struct sdhci_host *host) {}
+static inline void sdhci_basicdrv_std_debugfs_init(struct sdhci_host *host) {}
+static inline void imx6q_basicdrv_op_cost_enable(struct sdhci_host *host,
+	bool on) {}
+#endif
+
+/*
+ * sdhci_add_host() does not initiate CQHCI, split it up and put
+ * cqhci_init() in between when the controller has a CQE.
+ */
+static int basicdrv_add_host(struct sdhci_host *host)
+{
+	struct pltfm_imx_data *imx_data = esdhc_priv(host);
+	struct cqhci_host *cq_host;
+	bool dma64;
+	int ret;
+
+	if (!imx_data->has_cqe)
+		return sdhci_add_host(host);
+
+	ret = sdhci_setup_host(host);
+	if (ret)
+		return ret;
+
+	cq_host = devm_kzalloc(host->mmc->parent, sizeof(*cq_host), GFP_KERNEL);
+	if (!cq_host) {
+		ret = -ENOMEM;
+		goto cleanup;
+	}
+
+	cq_host->mmio = host->ioaddr + ESDHC_CQHCI_ADDR_OFFSET;
+	cq_host->ops = &imx6q_basicdrv_cqhci_ops;
+
+	dma64 = host->flags & SDHCI_USE_64_BIT_DMA;
+	if (dma64)
+		cq_host->caps |= CQHCI_TASK_DESC_SZ_128;
+
+	/* allocate _cq_host_ and basic initialization */
+	ret = cqhci_init(cq_host, host->mmc, dma64);
+	if (ret)
+		goto cleanup;
+
+	ret = __sdhci_add_host(host);
+	if (ret)
+		goto cleanup;
+
+	return 0;
+
+cleanup:
+	sdhci_cleanup_host(host);
+
+	return ret;
+}
+
+/* Spec compliant controller: "clk_ahb" + "clk_xin" (arasan binding) */
+static int sdhci_basicdrv_std_probe(struct platform_device *pdev,
+	struct sdhci_host *host)
+{
+	struct sdhci_pltfm_host *pltfm_host = sdhci_priv(host);
+	struct pltfm_imx_data *imx_data = sdhci_pltfm_priv(pltfm_host);
+	struct clk *clk_ahb, *clk_xin;
+	int ret;
+
+	clk_ahb = devm_clk_get(&pdev->dev, "clk_ahb");
+	clk_xin = devm_clk_get(&pdev->dev, "clk_xin");
+	if (IS_ERR(clk_ahb) || IS_ERR(clk_xin)) {
+		ret = PTR_ERR(IS_ERR(clk_ahb) ? clk_ahb : clk_xin);
+		if (ret != -EPROBE_DEFER)
+			dev_err(&pdev->dev, "Unable to fetch AHB/XIN clock resources\n");
+		goto err;
+	}
+
+	ret = clk_prepare_enable(clk_ahb);
+	if (ret)
+		goto err;
+	ret = clk_prepare_enable(clk_xin);
+	if (ret)
+		goto clk_dis_ahb;
+	imx_data->clk_ahb = clk_ahb;
+	pltfm_host->clk = clk_xin;
+
+	sdhci_get_of_property(pdev);
+	sdhci_basicdrv_std_parse_dma(pdev, host);
+
+	ret = mmc_of_parse(host->mmc);
+	if (ret)
+		goto clk_dis_xin;
+
+	ret = sdhci_add_host(host);
+	if (ret)
+		goto clk_dis_xin;
+
+	dev_info(&pdev->dev, "%s: %s transfers\n", mmc_hostname(host->mmc),
+		sdhci_basicdrv_dma_engine(host));
+	sdhci_basicdrv_std_debugfs_init(host);
+
+	return 0;
+
+clk_dis_xin:
+	clk_disable_unprepare(clk_xin);
+clk_dis_ahb:
+	clk_disable_unprepare(clk_ahb);
+err:
+	sdhci_pltfm_free(pdev);
+	return ret;
+}
+
 static int sdhci_basicdrv_probe(struct platform_device *pdev)
 {
 	struct sdhci_host *host;
+	struct sdhci_pltfm_host *pltfm_host;
+	struct pltfm_imx_data *imx_data;
 	int ret = 0;
 	struct clk *clk_ipg, *clk_ahb, *clk_per;
-	struct pinctrl *pins_default;
+	const struct esdhc_soc_data *socdata;
+
+	socdata = of_device_get_match_data(&pdev->dev);
+	if (!socdata)
+		socdata = &usdhc_imx6q_data;
 
-	host = sdhci_pltfm_init(pdev, &sdhci_basicdrv_pdata, 0);
+	host = sdhci_pltfm_init(pdev, socdata->pdata,
+			sizeof(struct pltfm_imx_data));
 	if (IS_ERR(host))
 		return PTR_ERR(host);
 
+	pltfm_host = sdhci_priv(host);
+	imx_data = sdhci_pltfm_priv(pltfm_host);
+	imx_data->host = host;
+	imx_data->socdata = socdata;
+	if (!esdhc_is_usdhc(imx_data))
+		return sdhci_basicdrv_std_probe(pdev, host);
+
+	imx_data->tune_tap = -1;	/* not tuned yet */
+	hrtimer_init(&imx_data->irq_timer, CLOCK_MONOTONIC, HRTIMER_MODE_REL);
+	imx_data->irq_timer.function = imx6q_basicdrv_irq_timer;
+	imx_data->sdhci_request = host->mmc_host_ops.request;
+	host->mmc_host_ops.request = imx6q_basicdrv_request;
+
+	imx_data->stats = devm_alloc_percpu(&pdev->dev, struct esdhc_stats);
+	if (!imx_data->stats) {
+		ret = -ENOMEM;
+		goto err;
+	}
+
 
 	/* Enable clock sources (IPG, AHB, PER) */
 	clk_ipg = devm_clk_get(&pdev->dev, "ipg");
 	clk_ahb = devm_clk_get(&pdev->dev, "ahb");
 	clk_per = devm_clk_get(&pdev->dev, "per");
 	if (IS_ERR(clk_ipg) || IS_ERR(clk_ahb) || IS_ERR(clk_per)) {
-		dev_err(&pdev->dev, "Unable to fetch IPG/AHB/PER clock resources\n");
+		ret = PTR_ERR(IS_ERR(clk_ipg) ? clk_ipg :
+			      IS_ERR(clk_ahb) ? clk_ahb : clk_per);
+		if (ret != -EPROBE_DEFER)
+			dev_err(&pdev->dev, "Unable to fetch IPG/AHB/PER clock resources\n");
 		goto err;
 	}
-	if (clk_prepare_enable(clk_per))	goto clk_err;
-	if (clk_prepare_enable(clk_ipg))	goto clk_err;
-	if (clk_prepare_enable(clk_ahb))	goto clk_err;
+	ret = clk_prepare_enable(clk_per);
+	if (ret)
+		goto err;
+	ret = clk_prepare_enable(clk_ipg);
+	if (ret)
+		goto err_per;
+	ret = clk_prepare_enable(clk_ahb);
+	if (ret)
+		goto err_ipg;
 
-	/* Set PINCTRL */
-	pins_default = devm_pinctrl_get_select_default(&pdev->dev);
+	/* PER clock feeds the SD clock dividers */
+	imx_data->clk_ipg = clk_ipg;
+	imx_data->clk_ahb = clk_ahb;
+	pltfm_host->clk = clk_per;
+	pltfm_host->clock = clk_get_rate(clk_per);
+	if (!pltfm_host->clock)
+		pltfm_host->clock = IMX6Q_HOST_CLOCK;
+
+	/*
+	 * Set PINCTRL
+	 * SDR50/DDR50 and SDR104 need stronger pads (state_100mhz,
+	 * state_200mhz). Without them stay at 3.3V high speed.
+	 */
+	imx_data->pinctrl = devm_pinctrl_get(&pdev->dev);
+	if (!IS_ERR(imx_data->pinctrl)) {
+		imx_data->pins_default = pinctrl_lookup_state(imx_data->pinctrl,
+						PINCTRL_STATE_DEFAULT);
+		imx_data->pins_100mhz = pinctrl_lookup_state(imx_data->pinctrl,
+						ESDHC_PINCTRL_STATE_100MHZ);
+		imx_data->pins_200mhz = pinctrl_lookup_state(imx_data->pinctrl,
+						ESDHC_PINCTRL_STATE_200MHZ);
+		if (!IS_ERR(imx_data->pins_default))
+			pinctrl_select_state(imx_data->pinctrl,
+					imx_data->pins_default);
+	}
+	if (IS_ERR(imx_data->pinctrl) ||
+		IS_ERR(imx_data->pins_100mhz) ||
+		IS_ERR(imx_data->pins_200mhz)) {
+		dev_warn(&pdev->dev,
+			"could not get ultra high speed state, work on normal mode\n");
+		/* fall back to not supporting uhs by specifying no 1.8v quirk */
+		host->quirks2 |= SDHCI_QUIRK2_NO_1_8_V;
+	}
 
 	/* Update QUIRKS */
 	host->quirks2 |= SDHCI_QUIRK2_PRESET_VALUE_BROKEN;
 	host->mmc->caps |= MMC_CAP_1_8V_DDR;
-	host->quirks2 |= SDHCI_QUIRK2_BROKEN_HS200;
+	if (!(imx_data->socdata->flags & ESDHC_FLAG_HS200))
+		host->quirks2 |= SDHCI_QUIRK2_BROKEN_HS200;
+	/* HS400 also needs HS200 and an 8-bit bus (mmc_of_parse) */
+	if (imx_data->socdata->flags & ESDHC_FLAG_HS400)
+		host->mmc->caps2 |= MMC_CAP2_HS400_1_8V;
 
 	/* clear tuning bits in case ROM has set it already */
-	writel(0x0, host->ioaddr + ESDHC_MIX_CTRL);
+	esdhc_sync_shadow(host);
+	esdhc_write_mix_ctrl(host, 0x0);
 	writel(0x0, host->ioaddr + SDHCI_ACMD12_ERR);
-	writel(0x0, host->ioaddr + ESDHC_TUNE_CTRL_STATUS);
+	esdhc_write_tune_ctrl(host, 0x0);
 
 
 	sdhci_get_of_property(pdev);
@@ -673,23 +2773,43 @@ static int sdhci_basicdrv_probe(struct platform_device *pdev)
 	ret = mmc_of_parse(host->mmc);
 	if (ret) {
 		dev_err(&pdev->dev, "parsing dt failed (%d)\n", ret);
-		goto err;
+		goto clk_err;
 	}
 
+	/*
+	 * With a "cd-gpios" card detect the GPIO interrupt (debounced by
+	 * the core) reports insert/remove, no need for the 1s slot polling.
+	 * Without it keep the quirk: MMC_CAP_NEEDS_POLL.
+	 */
+	if (mmc_gpio_get_cd(host->mmc) >= 0)
+		host->quirks &= ~SDHCI_QUIRK_BROKEN_CARD_DETECTION;
+
+	imx6q_basicdrv_parse_dt(pdev, host);
+	if (imx_data->has_cqe)
+		host->mmc->caps2 |= MMC_CAP2_CQE | MMC_CAP2_CQE_DCMD;
+
 
 	/* Errata */
 	imx6q_basicdrv_hwinit(host);
 
 
-	ret = sdhci_add_host(host);
+	ret = basicdrv_add_host(host);
 	if (ret)
-		goto err;
+		goto clk_err;
+
+	imx_data->clk_nb.notifier_call = imx6q_basicdrv_clk_notifier;
+	if (clk_notifier_register(clk_per, &imx_data->clk_nb))
+		dev_warn(&pdev->dev, "PER clock rate changes are not tracked\n");
+
+	imx6q_basicdrv_debugfs_init(host);
 
 	return 0;
 
 clk_err:
 	clk_disable_unprepare(clk_ahb);
+err_ipg:
 	clk_disable_unprepare(clk_ipg);
+err_per:
 	clk_disable_unprepare(clk_per);
 err:
 	sdhci_pltfm_free(pdev);
@@ -697,9 +2817,86 @@ err:
 	return ret;
 }
 
+static int sdhci_basicdrv_remove(struct platform_device *pdev)
+{
+	struct sdhci_host *host = platform_get_drvdata(pdev);
+	struct sdhci_pltfm_host *pltfm_host = sdhci_priv(host);
+	struct pltfm_imx_data *imx_data = sdhci_pltfm_priv(pltfm_host);
+	struct clk *clk_ipg = imx_data->clk_ipg;
+	struct clk *clk_ahb = imx_data->clk_ahb;
+	unsigned long flags;
+	int dead;
+
+	if (esdhc_is_usdhc(imx_data)) {
+		clk_notifier_unregister(pltfm_host->clk, &imx_data->clk_nb);
+		/* no new window, hand held completions back to the IRQ */
+		imx_data->irq_coalesce_us = 0;
+		hrtimer_cancel(&imx_data->irq_timer);
+		spin_lock_irqsave(&host->lock, flags);
+		if (imx_data->irq_held)
+			imx6q_basicdrv_irq_release(host);
+		spin_unlock_irqrestore(&host->lock, flags);
+	}
+
+	/*
+	 * sdhci_pltfm_unregister(), open coded: once the debugfs files are
+	 * gone with the host, drop this host from the MMIO accounting key.
+	 */
+	dead = (readl(host->ioaddr + SDHCI_INT_STATUS) == 0xffffffff);
+	sdhci_remove_host(host, dead);
+	imx6q_basicdrv_op_cost_enable(host, false);
+	clk_disable_unprepare(pltfm_host->clk);	/* PER */
+	sdhci_pltfm_free(pdev);
+
+	clk_disable_unprepare(clk_ahb);
+	clk_disable_unprepare(clk_ipg);
+
+	return 0;
+}
+
+#ifdef CONFIG_PM_SLEEP
+/*
+ * sdhci_pltfm_pmops plus the CQE: cqhci has to be halted before the
+ * host suspends and re-enabled once it has resumed.
+ */
+static int sdhci_basicdrv_suspend(struct device *dev)
+{
+	struct sdhci_host *host = dev_get_drvdata(dev);
+	int ret;
+
+	if (host->mmc->caps2 & MMC_CAP2_CQE) {
+		ret = cqhci_suspend(host->mmc);
+		if (ret)
+			return ret;
+	}
+
+	return sdhci_pltfm_suspend(dev);
+}
+
+static int sdhci_basicdrv_resume(struct device *dev)
+{
+	struct sdhci_host *host = dev_get_drvdata(dev);
+	int ret;
+
+	ret = sdhci_pltfm_resume(dev);
+	if (ret)
+		return ret;
+
+	if (host->mmc->caps2 & MMC_CAP2_CQE)
+		ret = cqhci_resume(host->mmc);
+
+	return ret;
+}
+#endif
+
+static SIMPLE_DEV_PM_OPS(sdhci_basicdrv_pmops, sdhci_basicdrv_suspend,
+	sdhci_basicdrv_resume);
+
 static const struct of_device_id sdhci_basicdrv_of_match[] = {
-	{ .compatible = "virtualcom,basicdrv-dwc_mshc" },
-	{ .compatible = "virtualcom,basicdrv-sdhci" },
+	{ .compatible = "virtualcom,basicdrv-dwc_mshc", .data = &usdhc_imx6q_data, },
+	{ .compatible = "virtualcom,basicdrv-sdhci", .data = &usdhc_imx6q_data, },
+	{ .compatible = "virtualcom,basicdrv-usdhc-hs400", .data = &usdhc_hs400_data, },
+	{ .compatible = "virtualcom,basicdrv-std-sdhci", .data = &sdhci_std_data, },
 	{ }
 };
 MODULE_DEVICE_TABLE(of, sdhci_basicdrv_of_match);
@@ -708,10 +2905,10 @@ static struct platform_driver sdhci_basicdrv_driver = {
 	.driver = {
 		.name = "sdhci-basicdrv",
 		.of_match_table = sdhci_basicdrv_of_match,
-		.pm = &sdhci_pltfm_pmops,
+		.pm = &sdhci_basicdrv_pmops,
 	},
 	.probe = sdhci_basicdrv_probe,
-	.remove = sdhci_pltfm_unregister,
+	.remove = sdhci_basicdrv_remove,
 };
 
 module_platform_driver(sdhci_basicdrv_driver);
@@ -719,3 +2916,7 @@ module_platform_driver(sdhci_basicdrv_driver);
 MODULE_DESCRIPTION("SDHCI OF driver for VirtualCOM BasicDrv DWC_mshc");
 MODULE_AUTHOR("Public Domain Virtual Company");
 MODULE_LICENSE("GPL v2");
+
+#ifdef CONFIG_MMC_SDHCI_OF_BASICDRV_KUNIT_TEST
+#include "sdhci-of-basicdrv-test.c"
+#endif